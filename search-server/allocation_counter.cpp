@@ -0,0 +1,71 @@
+#include "allocation_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+// операторы живут в отдельной единице трансляции: встроенные в код контейнеров,
+// они дают ложные предупреждения о free на указателе из operator new
+
+namespace {
+
+thread_local bool is_counting_allocations = false;
+thread_local size_t allocation_count = 0;
+
+}  // namespace
+
+void StartCountingAllocations() {
+    allocation_count = 0;
+    is_counting_allocations = true;
+}
+
+size_t StopCountingAllocations() {
+    is_counting_allocations = false;
+    return allocation_count;
+}
+
+// заменяются все невыровненные формы, чтобы выделение и освобождение всегда шли через malloc и free
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    if (is_counting_allocations) {
+        ++allocation_count;
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(std::size_t size) {
+    if (void* pointer = operator new(size, std::nothrow)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    std::free(pointer);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+
+// подсчёт выделений памяти текущим потоком. allocation_counter.cpp заменяет глобальные
+// operator new и delete, поэтому собирается только в тестовую программу, не в сервер
+void StartCountingAllocations();
+// число выделений с последнего StartCountingAllocations
+size_t StopCountingAllocations();
+
+template <typename Function>
+size_t CountAllocations(Function function) {
+    StartCountingAllocations();
+    function();
+    return StopCountingAllocations();
+}
\ No newline at end of file
@@ -0,0 +1,276 @@
+#include "compressed_postings.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define POSTING_CODEC_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define POSTING_CODEC_AVX2
+#else
+#define POSTING_CODEC_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+constexpr size_t ROWS = POSTING_BLOCK_SIZE / POSTING_BLOCK_LANES;
+
+uint32_t GetMask(unsigned bit_width) {
+    return bit_width == 32 ? UINT32_MAX : (uint32_t{1} << bit_width) - 1;
+}
+
+unsigned GetBitWidth(uint32_t value) {
+    unsigned bit_width = 0;
+    while (bit_width < 32 && (value >> bit_width) != 0) {
+        ++bit_width;
+    }
+    return bit_width;
+}
+
+[[maybe_unused]] void UnpackBlockScalar(const uint32_t* packed, unsigned bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        std::fill(values, values + POSTING_BLOCK_SIZE, 0);
+        return;
+    }
+    const uint32_t mask = GetMask(bit_width);
+    for (size_t lane = 0; lane < POSTING_BLOCK_LANES; ++lane) {
+        size_t word = 0;
+        unsigned shift = 0;
+        for (size_t row = 0; row < ROWS; ++row) {
+            uint32_t value = packed[word * POSTING_BLOCK_LANES + lane] >> shift;
+            if (shift + bit_width > 32) {
+                value |= packed[(word + 1) * POSTING_BLOCK_LANES + lane] << (32 - shift);
+            }
+            values[row * POSTING_BLOCK_LANES + lane] = value & mask;
+            shift += bit_width;
+            if (shift >= 32) {
+                shift -= 32;
+                ++word;
+            }
+        }
+    }
+}
+
+[[maybe_unused]] void PrefixSumScalar(uint32_t* values, uint32_t base) {
+    for (size_t i = 0; i < POSTING_BLOCK_SIZE; ++i) {
+        base += values[i];
+        values[i] = base;
+    }
+}
+
+#ifdef POSTING_CODEC_X86
+
+// сдвиги одинаковы для всех полос, поэтому строка из 4 полос распаковывается одной парой сдвигов
+void UnpackBlockSse2(const uint32_t* packed, unsigned bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        std::fill(values, values + POSTING_BLOCK_SIZE, 0);
+        return;
+    }
+    const __m128i mask = _mm_set1_epi32(static_cast<int>(GetMask(bit_width)));
+    for (size_t half = 0; half < 2; ++half) {
+        const uint32_t* lanes = packed + half * 4;
+        size_t word = 0;
+        unsigned shift = 0;
+        __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+        for (size_t row = 0; row < ROWS; ++row) {
+            __m128i value = _mm_srl_epi32(current, _mm_cvtsi32_si128(static_cast<int>(shift)));
+            if (shift + bit_width > 32) {
+                const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + (word + 1) * POSTING_BLOCK_LANES));
+                value = _mm_or_si128(value, _mm_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + row * POSTING_BLOCK_LANES + half * 4), _mm_and_si128(value, mask));
+            shift += bit_width;
+            if (shift >= 32) {
+                shift -= 32;
+                ++word;
+                if (row + 1 < ROWS) {
+                    current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + word * POSTING_BLOCK_LANES));
+                }
+            }
+        }
+    }
+}
+
+void PrefixSumSse2(uint32_t* values, uint32_t base) {
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t i = 0; i < POSTING_BLOCK_SIZE; i += 4) {
+        __m128i sum = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 4));
+        sum = _mm_add_epi32(sum, _mm_slli_si128(sum, 8));
+        sum = _mm_add_epi32(sum, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), sum);
+        carry = _mm_shuffle_epi32(sum, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+}
+
+POSTING_CODEC_AVX2 void UnpackBlockAvx2(const uint32_t* packed, unsigned bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        std::fill(values, values + POSTING_BLOCK_SIZE, 0);
+        return;
+    }
+    const __m256i mask = _mm256_set1_epi32(static_cast<int>(GetMask(bit_width)));
+    size_t word = 0;
+    unsigned shift = 0;
+    __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed));
+    for (size_t row = 0; row < ROWS; ++row) {
+        __m256i value = _mm256_srl_epi32(current, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        if (shift + bit_width > 32) {
+            const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + (word + 1) * POSTING_BLOCK_LANES));
+            value = _mm256_or_si256(value, _mm256_sll_epi32(next, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + row * POSTING_BLOCK_LANES), _mm256_and_si256(value, mask));
+        shift += bit_width;
+        if (shift >= 32) {
+            shift -= 32;
+            ++word;
+            if (row + 1 < ROWS) {
+                current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + word * POSTING_BLOCK_LANES));
+            }
+        }
+    }
+}
+
+#endif
+
+struct CodecKernels {
+    const char* name;
+    void (*unpack)(const uint32_t* packed, unsigned bit_width, uint32_t* values);
+    void (*prefix_sum)(uint32_t* values, uint32_t base);
+};
+
+CodecKernels SelectKernels() {
+#ifdef POSTING_CODEC_X86
+    if (CpuSupportsAvx2()) {
+        return {"avx2", UnpackBlockAvx2, PrefixSumSse2};
+    }
+    return {"sse2", UnpackBlockSse2, PrefixSumSse2};
+#else
+    return {"scalar", UnpackBlockScalar, PrefixSumScalar};
+#endif
+}
+
+const CodecKernels& GetKernels() {
+    static const CodecKernels kernels = SelectKernels();
+    return kernels;
+}
+
+}  // namespace
+
+size_t GetPackedWordCount(unsigned bit_width) {
+    return POSTING_BLOCK_LANES * ((ROWS * bit_width + 31) / 32);
+}
+
+void PackBlock(const uint32_t* values, unsigned bit_width, uint32_t* packed) {
+    std::fill(packed, packed + GetPackedWordCount(bit_width), 0);
+    if (bit_width == 0) {
+        return;
+    }
+    for (size_t lane = 0; lane < POSTING_BLOCK_LANES; ++lane) {
+        size_t word = 0;
+        unsigned shift = 0;
+        for (size_t row = 0; row < ROWS; ++row) {
+            const uint32_t value = values[row * POSTING_BLOCK_LANES + lane];
+            packed[word * POSTING_BLOCK_LANES + lane] |= value << shift;
+            if (shift + bit_width > 32) {
+                packed[(word + 1) * POSTING_BLOCK_LANES + lane] |= value >> (32 - shift);
+            }
+            shift += bit_width;
+            if (shift >= 32) {
+                shift -= 32;
+                ++word;
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t* packed, unsigned bit_width, uint32_t* values) {
+    GetKernels().unpack(packed, bit_width, values);
+}
+
+void UnpackDeltaBlock(const uint32_t* packed, unsigned bit_width, uint32_t base, uint32_t* values) {
+    const CodecKernels& kernels = GetKernels();
+    kernels.unpack(packed, bit_width, values);
+    kernels.prefix_sum(values, base);
+}
+
+const char* GetPostingCodecName() {
+    return GetKernels().name;
+}
+
+CompressedPostings::CompressedPostings(const uint32_t* slots, const double* term_freqs, size_t size)
+    : size_(size) {
+    term_freq_values_.assign(term_freqs, term_freqs + size);
+    std::sort(term_freq_values_.begin(), term_freq_values_.end());
+    term_freq_values_.erase(std::unique(term_freq_values_.begin(), term_freq_values_.end()), term_freq_values_.end());
+    term_freq_values_.shrink_to_fit();
+
+    uint32_t deltas[POSTING_BLOCK_SIZE];
+    uint32_t codes[POSTING_BLOCK_SIZE];
+    for (size_t first = 0; first < size; first += POSTING_BLOCK_SIZE) {
+        const size_t count = std::min(POSTING_BLOCK_SIZE, size - first);
+        uint32_t max_delta = 0;
+        uint32_t max_code = 0;
+        for (size_t i = 0; i < POSTING_BLOCK_SIZE; ++i) {
+            if (i >= count) {
+                deltas[i] = codes[i] = 0;
+                continue;
+            }
+            // первая разность нулевая: отсчёт идёт от first_slot блока
+            deltas[i] = i == 0 ? 0 : slots[first + i] - slots[first + i - 1];
+            codes[i] = static_cast<uint32_t>(std::lower_bound(term_freq_values_.begin(), term_freq_values_.end(), term_freqs[first + i])
+                - term_freq_values_.begin());
+            max_delta = std::max(max_delta, deltas[i]);
+            max_code = std::max(max_code, codes[i]);
+        }
+        BlockHeader header{slots[first], slots[first + count - 1], static_cast<uint32_t>(words_.size()),
+            static_cast<uint8_t>(GetBitWidth(max_delta)), static_cast<uint8_t>(GetBitWidth(max_code)), static_cast<uint16_t>(count)};
+        const size_t slot_words = GetPackedWordCount(header.slot_bits);
+        words_.resize(words_.size() + slot_words + GetPackedWordCount(header.freq_bits));
+        PackBlock(deltas, header.slot_bits, words_.data() + header.offset);
+        PackBlock(codes, header.freq_bits, words_.data() + header.offset + slot_words);
+        blocks_.push_back(header);
+    }
+    blocks_.shrink_to_fit();
+    words_.shrink_to_fit();
+}
+
+size_t CompressedPostings::size() const {
+    return size_;
+}
+
+size_t CompressedPostings::GetBlockCount() const {
+    return blocks_.size();
+}
+
+uint32_t CompressedPostings::GetBlockFirstSlot(size_t block) const {
+    return blocks_[block].first_slot;
+}
+
+uint32_t CompressedPostings::GetBlockLastSlot(size_t block) const {
+    return blocks_[block].last_slot;
+}
+
+size_t CompressedPostings::FindBlock(uint32_t slot, size_t first_block) const {
+    return std::partition_point(blocks_.begin() + first_block, blocks_.end(), [slot](const BlockHeader& header) {
+        return header.last_slot < slot;
+    }) - blocks_.begin();
+}
+
+size_t CompressedPostings::DecodeBlock(size_t block, uint32_t* slots, double* term_freqs) const {
+    const BlockHeader& header = blocks_[block];
+    const uint32_t* packed = words_.data() + header.offset;
+    UnpackDeltaBlock(packed, header.slot_bits, header.first_slot, slots);
+    uint32_t codes[POSTING_BLOCK_SIZE];
+    UnpackBlock(packed + GetPackedWordCount(header.slot_bits), header.freq_bits, codes);
+    for (size_t i = 0; i < header.size; ++i) {
+        term_freqs[i] = term_freq_values_[codes[i]];
+    }
+    return header.size;
+}
+
+size_t CompressedPostings::GetMemoryUsage() const {
+    return sizeof(*this) + blocks_.capacity() * sizeof(BlockHeader) + words_.capacity() * sizeof(uint32_t)
+        + term_freq_values_.capacity() * sizeof(double);
+}
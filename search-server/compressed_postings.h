@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// блок упакованных значений: 128 чисел по bit_width бит в 8 чередующихся полосах
+// (число i лежит в полосе i % 8), так что распаковка идёт сразу по 8 (AVX2) или 4 (SSE) полосам
+constexpr size_t POSTING_BLOCK_SIZE = 128;
+constexpr size_t POSTING_BLOCK_LANES = 8;
+
+size_t GetPackedWordCount(unsigned bit_width);
+void PackBlock(const uint32_t* values, unsigned bit_width, uint32_t* packed);
+// ядро (AVX2, SSE2 или скалярное) выбирается один раз по возможностям процессора
+void UnpackBlock(const uint32_t* packed, unsigned bit_width, uint32_t* values);
+// распаковка разностей с префиксной суммой: values[i] = base + delta[0] + ... + delta[i]
+void UnpackDeltaBlock(const uint32_t* packed, unsigned bit_width, uint32_t base, uint32_t* values);
+const char* GetPostingCodecName();
+
+// неизменяемый сжатый список вхождений: разности слотов упакованы блоками по 128,
+// частоты заменены номерами в словаре различных частот списка, поэтому хранятся без потерь
+class CompressedPostings {
+public:
+    CompressedPostings() = default;
+    // слоты строго возрастают, надгробий нет
+    CompressedPostings(const uint32_t* slots, const double* term_freqs, size_t size);
+
+    size_t size() const;
+    size_t GetBlockCount() const;
+    uint32_t GetBlockFirstSlot(size_t block) const;
+    uint32_t GetBlockLastSlot(size_t block) const;
+    // первый блок из [first_block, GetBlockCount()), последний слот которого не меньше slot
+    size_t FindBlock(uint32_t slot, size_t first_block = 0) const;
+    // возвращает число вхождений в блоке, буферы вмещают POSTING_BLOCK_SIZE элементов
+    size_t DecodeBlock(size_t block, uint32_t* slots, double* term_freqs) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    struct BlockHeader {
+        uint32_t first_slot;
+        uint32_t last_slot;
+        uint32_t offset;
+        uint8_t slot_bits;
+        uint8_t freq_bits;
+        uint16_t size;
+    };
+
+    std::vector<BlockHeader> blocks_;
+    std::vector<uint32_t> words_;
+    std::vector<double> term_freq_values_;
+    size_t size_ = 0;
+};
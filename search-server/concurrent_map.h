@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
-#include <map>
+#include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 #include "log_duration.h"
@@ -11,58 +16,248 @@
 
 using namespace std::string_literals;
 
+// хэш-таблица с открытой адресацией, поделённая на полосы по кэш-линиям.
+// существующие ключи обновляются под разделяемой блокировкой полосы через CAS,
+// исключительная блокировка нужна только для роста таблицы и удаления.
+// сервер её не использует, она оставлена для внешних вызовов и BenchmarkConcurrentMap
 template <typename Key, typename Value>
 class ConcurrentMap {
 private:
-    struct Bucket {
-        std::mutex mutex;
-        std::map<Key, Value> map;
+    enum SlotState : uint8_t {
+        EMPTY,
+        BUSY,
+        FULL,
+    };
+
+    struct Slot {
+        std::atomic<uint8_t> state{EMPTY};
+        Key key{};
+        std::atomic<Value> value{};
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex mutex;
+        std::unique_ptr<Slot[]> slots;
+        size_t capacity = 0;
+        std::atomic<size_t> size{0};
     };
 
 public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys"s);
+    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+    static_assert(std::is_trivially_copyable_v<Value>, "ConcurrentMap supports only trivially copyable values");
 
-    struct Access {
-        std::lock_guard<std::mutex> guard;
-        Value& ref_to_value;
+    class Access {
+    public:
+        Access(ConcurrentMap& map, const Key& key)
+            : map_(map)
+            , key_(key) {
+        }
 
-        Access(const Key& key, Bucket& bucket)
-            : guard(bucket.mutex)
-            , ref_to_value(bucket.map[key]) {
+        Access& operator+=(const Value& value) {
+            map_.Add(key_, value);
+            return *this;
         }
+
+        Access& operator=(const Value& value) {
+            map_.Store(key_, value);
+            return *this;
+        }
+
+        operator Value() const {
+            return map_.Get(key_);
+        }
+
+    private:
+        ConcurrentMap& map_;
+        Key key_;
     };
-   
-    void Delete(const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        bucket.map.erase(key);
-    }
 
-    explicit ConcurrentMap(size_t bucket_count)
-        : buckets_(bucket_count) {
+    explicit ConcurrentMap(size_t stripe_count)
+        : stripes_(stripe_count == 0 ? 1 : stripe_count) {
     }
 
     Access operator[](const Key& key) {
-        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
-        return { key, bucket };
+        return {*this, key};
+    }
+
+    void Add(const Key& key, const Value& value) {
+        Update(key, [&value](std::atomic<Value>& target) {
+            Value expected = target.load(std::memory_order_relaxed);
+            while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed)) {
+            }
+        });
     }
 
-    Access operator+(const Value& value) {
-        return this.ref_to_value + value;
+    void Store(const Key& key, const Value& value) {
+        Update(key, [&value](std::atomic<Value>& target) {
+            target.store(value, std::memory_order_relaxed);
+        });
     }
 
-    Access operator+=(const Value& value) {
-        return this + value;
+    Value Get(const Key& key) const {
+        const uint64_t hash = Hash(key);
+        const Stripe& stripe = GetStripe(hash);
+        std::shared_lock guard(stripe.mutex);
+        const Slot* slot = Find(stripe, key, hash);
+        return slot == nullptr ? Value{} : slot->value.load(std::memory_order_relaxed);
     }
 
-    std::map<Key, Value> BuildOrdinaryMap() {
-        std::map<Key, Value> result;
-        for (auto& [mutex, map] : buckets_) {
-            std::lock_guard g(mutex);
-            result.insert(map.begin(), map.end());
+    void Delete(const Key& key) {
+        const uint64_t hash = Hash(key);
+        Stripe& stripe = GetStripe(hash);
+        std::unique_lock guard(stripe.mutex);
+        Slot* slot = const_cast<Slot*>(Find(stripe, key, hash));
+        if (slot == nullptr) {
+            return;
+        }
+        // сдвигаем назад следующие элементы цепочки, чтобы обойтись без надгробий
+        const size_t mask = stripe.capacity - 1;
+        size_t hole = slot - stripe.slots.get();
+        for (size_t pos = (hole + 1) & mask; stripe.slots[pos].state.load(std::memory_order_relaxed) == FULL; pos = (pos + 1) & mask) {
+            const size_t home = Hash(stripe.slots[pos].key) & mask;
+            if (((pos - home) & mask) >= ((pos - hole) & mask)) {
+                MoveSlot(stripe.slots[pos], stripe.slots[hole]);
+                hole = pos;
+            }
+        }
+        stripe.slots[hole].state.store(EMPTY, std::memory_order_relaxed);
+        stripe.size.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    std::unordered_map<Key, Value> BuildOrdinaryMap() const {
+        std::unordered_map<Key, Value> result;
+        size_t total_size = 0;
+        for (const Stripe& stripe : stripes_) {
+            total_size += stripe.size.load(std::memory_order_relaxed);
+        }
+        result.reserve(total_size);
+        for (const Stripe& stripe : stripes_) {
+            std::shared_lock guard(stripe.mutex);
+            for (size_t pos = 0; pos < stripe.capacity; ++pos) {
+                const Slot& slot = stripe.slots[pos];
+                if (slot.state.load(std::memory_order_acquire) == FULL) {
+                    result.emplace(slot.key, slot.value.load(std::memory_order_relaxed));
+                }
+            }
         }
         return result;
     }
 
 private:
-    std::vector<Bucket> buckets_;
-};
\ No newline at end of file
+    std::vector<Stripe> stripes_;
+
+    static uint64_t Hash(const Key& key) {
+        uint64_t hash = static_cast<uint64_t>(key);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    Stripe& GetStripe(uint64_t hash) {
+        return stripes_[(hash >> 32) % stripes_.size()];
+    }
+
+    const Stripe& GetStripe(uint64_t hash) const {
+        return stripes_[(hash >> 32) % stripes_.size()];
+    }
+
+    static const Slot* Find(const Stripe& stripe, const Key& key, uint64_t hash) {
+        if (stripe.capacity == 0) {
+            return nullptr;
+        }
+        const size_t mask = stripe.capacity - 1;
+        for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            const Slot& slot = stripe.slots[pos];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            while (state == BUSY) {
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (state == EMPTY) {
+                return nullptr;
+            }
+            if (slot.key == key) {
+                return &slot;
+            }
+        }
+    }
+
+    template <typename Function>
+    void Update(const Key& key, Function function) {
+        const uint64_t hash = Hash(key);
+        Stripe& stripe = GetStripe(hash);
+        {
+            std::shared_lock guard(stripe.mutex);
+            if (TryUpdate(stripe, key, hash, function)) {
+                return;
+            }
+        }
+        std::unique_lock guard(stripe.mutex);
+        if (!TryUpdate(stripe, key, hash, function)) {
+            Grow(stripe);
+            TryUpdate(stripe, key, hash, function);
+        }
+    }
+
+    // false, если ключа нет и для него не хватает места без роста таблицы
+    template <typename Function>
+    static bool TryUpdate(Stripe& stripe, const Key& key, uint64_t hash, Function& function) {
+        if (stripe.capacity == 0) {
+            return false;
+        }
+        const size_t mask = stripe.capacity - 1;
+        for (size_t pos = hash & mask;;) {
+            Slot& slot = stripe.slots[pos];
+            uint8_t state = slot.state.load(std::memory_order_acquire);
+            if (state == BUSY) {
+                continue;
+            }
+            if (state == FULL) {
+                if (slot.key == key) {
+                    function(slot.value);
+                    return true;
+                }
+                pos = (pos + 1) & mask;
+                continue;
+            }
+            // место резервируется до захвата ячейки: иначе потоки, одновременно прошедшие проверку,
+            // заполнили бы полосу целиком, и поиск отсутствующего ключа не нашёл бы пустой ячейки
+            if ((stripe.size.fetch_add(1, std::memory_order_relaxed) + 1) * 2 > stripe.capacity) {
+                stripe.size.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            if (slot.state.compare_exchange_strong(state, BUSY, std::memory_order_acquire)) {
+                slot.key = key;
+                slot.value.store(Value{}, std::memory_order_relaxed);
+                function(slot.value);
+                slot.state.store(FULL, std::memory_order_release);
+                return true;
+            }
+            stripe.size.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    static void MoveSlot(Slot& from, Slot& to) {
+        to.key = from.key;
+        to.value.store(from.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        to.state.store(FULL, std::memory_order_relaxed);
+    }
+
+    static void Grow(Stripe& stripe) {
+        const size_t old_capacity = stripe.capacity;
+        std::unique_ptr<Slot[]> old_slots = std::move(stripe.slots);
+        stripe.capacity = old_capacity == 0 ? 16 : old_capacity * 2;
+        stripe.slots = std::make_unique<Slot[]>(stripe.capacity);
+        const size_t mask = stripe.capacity - 1;
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_slots[i].state.load(std::memory_order_relaxed) != FULL) {
+                continue;
+            }
+            size_t pos = Hash(old_slots[i].key) & mask;
+            while (stripe.slots[pos].state.load(std::memory_order_relaxed) == FULL) {
+                pos = (pos + 1) & mask;
+            }
+            MoveSlot(old_slots[i], stripe.slots[pos]);
+        }
+    }
+};
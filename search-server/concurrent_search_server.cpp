@@ -0,0 +1,84 @@
+#include "concurrent_search_server.h"
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::GetSnapshot() const {
+    std::lock_guard guard(published_mutex_);
+    return published_;
+}
+
+uint64_t ConcurrentSearchServer::GetGeneration() const {
+    return generation_.load(std::memory_order_acquire);
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                                         const std::vector<int>& ratings) {
+    ApplyToDraft([document_id, text = std::string(document), status, ratings](SearchServer& server) {
+        server.AddDocument(document_id, text, status, ratings);
+    });
+}
+
+void ConcurrentSearchServer::AddDocuments(std::vector<NewDocument> documents) {
+    // тексты копируются в журнал, чтобы повтор не зависел от буферов вызывающего
+    auto texts = std::make_shared<std::vector<std::string>>();
+    texts->reserve(documents.size());
+    for (NewDocument& document : documents) {
+        texts->emplace_back(document.text);
+        document.text = texts->back();
+    }
+    ApplyToDraft([documents = std::move(documents), texts](SearchServer& server) {
+        server.AddDocuments(std::execution::par, documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    ApplyToDraft([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::Update(std::function<void(SearchServer&)> update) {
+    ApplyToDraft(std::move(update));
+}
+
+void ConcurrentSearchServer::ApplyToDraft(std::function<void(SearchServer&)> update) {
+    std::lock_guard guard(write_mutex_);
+    update(*draft_);
+    journal_.push_back(std::move(update));
+}
+
+void ConcurrentSearchServer::Publish() {
+    std::lock_guard guard(write_mutex_);
+    if (journal_.empty()) {
+        return;
+    }
+    const auto previous_signal = published_signal_;
+    std::shared_ptr<const SearchServer> previous = MakePublished(*draft_);
+    {
+        std::lock_guard published_guard(published_mutex_);
+        published_.swap(previous);
+    }
+    // своя ссылка на старую копию отпускается вне замка: её удалитель может взвести сигнал
+    previous.reset();
+    generation_.fetch_add(1, std::memory_order_release);
+    active_.swap(draft_);
+
+    // новых ссылок на старую копию больше не появится, остаётся дождаться уже взятых
+    {
+        std::unique_lock lock(previous_signal->mutex);
+        previous_signal->released_cv.wait(lock, [&previous_signal] {
+            return previous_signal->released;
+        });
+    }
+    for (const auto& update : journal_) {
+        update(*draft_);
+    }
+    journal_.clear();
+}
+
+std::shared_ptr<const SearchServer> ConcurrentSearchServer::MakePublished(const SearchServer& server) {
+    published_signal_ = std::make_shared<ReleaseSignal>();
+    return std::shared_ptr<const SearchServer>(&server, [signal = published_signal_](const SearchServer*) {
+        std::lock_guard guard(signal->mutex);
+        signal->released = true;
+        signal->released_cv.notify_all();
+    });
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "search_server.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// SearchServer для чтения во время записи. читатели берут неизменяемый снимок копией shared_ptr
+// под коротким замком и никогда не ждут писателя. у сервера две копии индекса: писатель меняет невидимую,
+// Publish атомарно делает её видимой, дожидается ухода читателей со старой и повторяет на ней
+// журнал изменений, после чего старая копия снова становится черновиком
+class ConcurrentSearchServer {
+public:
+    // аргумент передаётся обоим конструкторам SearchServer: стоп-слова или IndexSnapshotPath
+    template <typename Argument>
+    explicit ConcurrentSearchServer(const Argument& argument);
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    // снимок последнего опубликованного поколения, остаётся целым, пока на него есть ссылка;
+    // снимки не должны переживать сам ConcurrentSearchServer
+    std::shared_ptr<const SearchServer> GetSnapshot() const;
+    uint64_t GetGeneration() const;
+
+    // изменения копятся в черновике и становятся видны после Publish. ошибка изменения
+    // пробрасывается сразу и в журнал не попадает, поэтому бросившее изменение не должно
+    // успеть поменять сервер: так ведут себя AddDocument, AddDocuments и RemoveDocument
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void AddDocuments(std::vector<NewDocument> documents);
+    void RemoveDocument(int document_id);
+    // произвольное изменение, например EnableQueryCache или CompressPostings; повторяется
+    // на второй копии, поэтому должно давать тот же результат и не ссылаться на внешние данные
+    void Update(std::function<void(SearchServer&)> update);
+
+    // ждёт, пока читатели отпустят предыдущее поколение, поэтому долгие снимки задерживают писателя
+    void Publish();
+
+private:
+    // взводится, когда отпущена последняя ссылка на опубликованную копию
+    struct ReleaseSignal {
+        std::mutex mutex;
+        std::condition_variable released_cv;
+        bool released = false;
+    };
+
+    std::mutex write_mutex_;
+    std::unique_ptr<SearchServer> active_;
+    std::unique_ptr<SearchServer> draft_;
+    std::shared_ptr<ReleaseSignal> published_signal_;
+    // замок держится только на копировании и замене указателя
+    mutable std::mutex published_mutex_;
+    // копией не владеет, а при уходе последнего читателя взводит published_signal_
+    std::shared_ptr<const SearchServer> published_;
+    std::vector<std::function<void(SearchServer&)>> journal_;
+    std::atomic<uint64_t> generation_{0};
+
+    void ApplyToDraft(std::function<void(SearchServer&)> update);
+    std::shared_ptr<const SearchServer> MakePublished(const SearchServer& server);
+};
+
+template <typename Argument>
+ConcurrentSearchServer::ConcurrentSearchServer(const Argument& argument)
+    : active_(std::make_unique<SearchServer>(argument))
+    , draft_(std::make_unique<SearchServer>(argument))
+    , published_(MakePublished(*active_)) {
+}
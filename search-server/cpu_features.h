@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// процессор и ОС поддерживают AVX2; проверяется при каждом вызове, результат стоит запомнить
+bool CpuSupportsAvx2();
+
+// номер младшего единичного бита, bits != 0
+inline unsigned CountTrailingZeros(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&index, bits);
+#else
+    if (!_BitScanForward(&index, static_cast<unsigned long>(bits))) {
+        _BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+        index += 32;
+    }
+#endif
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+}
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 struct Document {
     Document();
@@ -20,4 +22,19 @@ enum class DocumentStatus {
     IRRELEVANT,
     BANNED,
     REMOVED,
+};
+
+// что делать с документом, набор слов которого совпадает с уже добавленным
+enum class DuplicatePolicy {
+    ALLOW,
+    REJECT,
+    FLAG,
+};
+
+// документ для пакетного добавления через SearchServer::AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
 };
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "document_filter.h"
+
+#include <algorithm>
+
+namespace {
+
+void SortUnique(std::vector<int>& ids) {
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+}  // namespace
+
+DocumentFilter& DocumentFilter::SetStatuses(std::initializer_list<DocumentStatus> statuses) {
+    status_mask_ = 0;
+    for (const DocumentStatus status : statuses) {
+        status_mask_ |= uint32_t{1} << static_cast<int>(status);
+    }
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetRatingRange(int min_rating, int max_rating) {
+    min_rating_ = min_rating;
+    max_rating_ = max_rating;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::SetIdRange(int min_id, int max_id) {
+    min_id_ = min_id;
+    max_id_ = max_id;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::AllowIds(std::vector<int> ids) {
+    SortUnique(ids);
+    allowed_ids_ = std::move(ids);
+    has_allowed_ids_ = true;
+    return *this;
+}
+
+DocumentFilter& DocumentFilter::DenyIds(std::vector<int> ids) {
+    SortUnique(ids);
+    denied_ids_ = std::move(ids);
+    return *this;
+}
+
+bool DocumentFilter::operator()(int document_id, DocumentStatus status, int rating) const {
+    return ((status_mask_ >> static_cast<int>(status)) & 1) != 0
+        && rating >= min_rating_ && rating <= max_rating_
+        && document_id >= min_id_ && document_id <= max_id_
+        && (!has_allowed_ids_ || std::binary_search(allowed_ids_.begin(), allowed_ids_.end(), document_id))
+        && !std::binary_search(denied_ids_.begin(), denied_ids_.end(), document_id);
+}
+
+uint32_t DocumentFilter::GetStatusMask() const {
+    return status_mask_;
+}
+
+int DocumentFilter::GetMinRating() const {
+    return min_rating_;
+}
+
+int DocumentFilter::GetMaxRating() const {
+    return max_rating_;
+}
+
+int DocumentFilter::GetMinId() const {
+    return min_id_;
+}
+
+int DocumentFilter::GetMaxId() const {
+    return max_id_;
+}
+
+bool DocumentFilter::HasAllowedIds() const {
+    return has_allowed_ids_;
+}
+
+const std::vector<int>& DocumentFilter::GetAllowedIds() const {
+    return allowed_ids_;
+}
+
+const std::vector<int>& DocumentFilter::GetDeniedIds() const {
+    return denied_ids_;
+}
\ No newline at end of file
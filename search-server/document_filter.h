@@ -0,0 +1,45 @@
+#pragma once
+#include "document.h"
+
+#include <climits>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// декларативный фильтр документов для FindTopDocuments. в отличие от лямбды, его условия видны серверу:
+// он сверяет их со сводками блоков слотов и пропускает в списках вхождений целые блоки, а списки id
+// превращает в битовые карты слотов. условия объединяются по И, по умолчанию подходит любой живой документ.
+// фильтр можно передать и туда, где ждут предикат (id, статус, рейтинг)
+class DocumentFilter {
+public:
+    DocumentFilter& SetStatuses(std::initializer_list<DocumentStatus> statuses);
+    // границы включаются
+    DocumentFilter& SetRatingRange(int min_rating, int max_rating);
+    DocumentFilter& SetIdRange(int min_id, int max_id);
+    // подходят только документы с этими id
+    DocumentFilter& AllowIds(std::vector<int> ids);
+    DocumentFilter& DenyIds(std::vector<int> ids);
+
+    bool operator()(int document_id, DocumentStatus status, int rating) const;
+
+    // бит i - подходит статус с номером i
+    uint32_t GetStatusMask() const;
+    int GetMinRating() const;
+    int GetMaxRating() const;
+    int GetMinId() const;
+    int GetMaxId() const;
+    bool HasAllowedIds() const;
+    // отсортированы, без повторов
+    const std::vector<int>& GetAllowedIds() const;
+    const std::vector<int>& GetDeniedIds() const;
+
+private:
+    uint32_t status_mask_ = UINT32_MAX;
+    int min_rating_ = INT_MIN;
+    int max_rating_ = INT_MAX;
+    int min_id_ = INT_MIN;
+    int max_id_ = INT_MAX;
+    bool has_allowed_ids_ = false;
+    std::vector<int> allowed_ids_;
+    std::vector<int> denied_ids_;
+};
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "document_fingerprint.h"
+
+namespace {
+
+uint64_t MixHash(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// FNV-1a с перемешиванием в конце; результат не зависит от платформы, поэтому попадает в снимок
+uint64_t HashWord(std::string_view word, uint64_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ seed;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    return MixHash(hash + word.size());
+}
+
+}  // namespace
+
+void DocumentFingerprint::AddWord(std::string_view word) {
+    low += HashWord(word, 0);
+    high += HashWord(word, 0x9e3779b97f4a7c15ULL);
+}
+
+bool DocumentFingerprint::operator==(const DocumentFingerprint& other) const {
+    return low == other.low && high == other.high;
+}
+
+bool DocumentFingerprint::operator!=(const DocumentFingerprint& other) const {
+    return !(*this == other);
+}
+
+size_t DocumentFingerprintHasher::operator()(const DocumentFingerprint& fingerprint) const {
+    return static_cast<size_t>(fingerprint.low ^ (fingerprint.high * 0x9e3779b97f4a7c15ULL));
+}
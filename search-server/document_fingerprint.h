@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 128-битный отпечаток набора уникальных слов документа: сумма отпечатков слов по модулю 2^64
+// в каждой половине, поэтому не зависит от порядка слов и от id терминов конкретного сервера
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    void AddWord(std::string_view word);
+
+    bool operator==(const DocumentFingerprint& other) const;
+    bool operator!=(const DocumentFingerprint& other) const;
+};
+
+struct DocumentFingerprintHasher {
+    size_t operator()(const DocumentFingerprint& fingerprint) const;
+};
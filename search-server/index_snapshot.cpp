@@ -0,0 +1,160 @@
+#include "index_snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std::literals;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+    file_handle_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE) {
+        file_handle_ = nullptr;
+        throw std::runtime_error("Cannot open index snapshot "s + path);
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle_, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file_handle_);
+        throw std::runtime_error("Cannot map index snapshot "s + path);
+    }
+    mapping_handle_ = CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping_handle_ ? MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (view == nullptr) {
+        if (mapping_handle_) {
+            CloseHandle(mapping_handle_);
+        }
+        CloseHandle(file_handle_);
+        throw std::runtime_error("Cannot map index snapshot "s + path);
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_handle_);
+    CloseHandle(file_handle_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open index snapshot "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Cannot map index snapshot "s + path);
+    }
+    void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Cannot map index snapshot "s + path);
+    }
+    data_ = static_cast<const char*>(view);
+    size_ = static_cast<size_t>(file_stat.st_size);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+#endif
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp"s)
+    , out_(temporary_path_, std::ios::binary | std::ios::trunc) {
+    if (!out_) {
+        throw std::runtime_error("Cannot create index snapshot "s + path);
+    }
+    // место под заголовок, он дописывается в Finish()
+    const SnapshotHeader empty_header{};
+    WriteArray(&empty_header, 1);
+}
+
+std::pair<uint64_t, uint64_t> SnapshotWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    uint64_t total_size = 0;
+    for (std::string_view str : strings) {
+        offsets.push_back(total_size);
+        total_size += str.size();
+    }
+    offsets.push_back(total_size);
+    const uint64_t offsets_position = WriteArray(offsets);
+    const uint64_t bytes_position = WriteArray<char>(nullptr, 0);
+    for (std::string_view str : strings) {
+        out_.write(str.data(), static_cast<std::streamsize>(str.size()));
+    }
+    position_ += total_size;
+    return {offsets_position, bytes_position};
+}
+
+void SnapshotWriter::Finish(const SnapshotHeader& header) {
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Cannot write index snapshot "s + path_);
+    }
+    std::filesystem::rename(temporary_path_, path_);
+}
+
+void SnapshotWriter::Align() {
+    static const char padding[8] = {};
+    const uint64_t padding_size = (8 - position_ % 8) % 8;
+    out_.write(padding, static_cast<std::streamsize>(padding_size));
+    position_ += padding_size;
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file)
+    : file_(file)
+    , header_(GetArray<SnapshotHeader>(0, 1)) {
+    if (std::memcmp(header_->magic, SnapshotHeader::MAGIC, sizeof(SnapshotHeader::MAGIC)) != 0
+        || header_->byte_order_mark != SnapshotHeader::BYTE_ORDER_MARK) {
+        throw std::runtime_error("File is not an index snapshot"s);
+    }
+    if (header_->version != SnapshotHeader::VERSION) {
+        throw std::runtime_error("Unsupported index snapshot version "s + std::to_string(header_->version));
+    }
+}
+
+const SnapshotHeader& SnapshotReader::GetHeader() const {
+    return *header_;
+}
+
+std::vector<std::string_view> SnapshotReader::GetStrings(uint64_t count, uint64_t offsets, uint64_t bytes) const {
+    const uint64_t* string_offsets = GetArray<uint64_t>(offsets, count + 1);
+    const char* string_bytes = GetArray<char>(bytes, string_offsets[count]);
+    std::vector<std::string_view> result;
+    result.reserve(count);
+    for (uint64_t i = 0; i < count; ++i) {
+        if (string_offsets[i] > string_offsets[i + 1] || string_offsets[i + 1] > string_offsets[count]) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+        result.emplace_back(string_bytes + string_offsets[i], string_offsets[i + 1] - string_offsets[i]);
+    }
+    return result;
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// путь к снимку индекса, сохранённому SearchServer::Save()
+struct IndexSnapshotPath {
+    std::string path;
+};
+
+// файл, целиком отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const;
+    size_t size() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+};
+
+// заголовок снимка. все массивы выровнены по 8 байт и лежат в порядке хоста,
+// строки хранятся как массив смещений (count + 1) и общий блок байт
+struct SnapshotHeader {
+    static constexpr char MAGIC[8] = {'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0'};
+    static constexpr uint32_t VERSION = 3;
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+    uint64_t max_result_document_count;
+
+    uint64_t stop_word_count;
+    uint64_t stop_word_offsets;
+    uint64_t stop_word_bytes;
+
+    uint64_t term_count;
+    uint64_t term_offsets;
+    uint64_t term_bytes;
+
+    uint64_t posting_count;
+    uint64_t posting_offsets;
+    uint64_t posting_slots;
+    uint64_t posting_term_freqs;
+    uint64_t posting_max_term_freqs;
+
+    uint64_t document_count;
+    uint64_t document_ids;
+    uint64_t document_ratings;
+    uint64_t document_statuses;
+
+    uint64_t forward_count;
+    uint64_t forward_offsets;
+    uint64_t forward_terms;
+    uint64_t forward_term_freqs;
+
+    // DuplicatePolicy и отпечатки документов (low, high), если политика не ALLOW
+    uint64_t duplicate_policy;
+    uint64_t document_fingerprints;
+};
+
+// пишет во временный файл и в Finish() атомарно подменяет им целевой,
+// так что уже отображённый старый снимок остаётся целым
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    // возвращает смещение записанного массива от начала файла
+    template <typename T>
+    uint64_t WriteArray(const T* data, size_t count);
+
+    template <typename T>
+    uint64_t WriteArray(const std::vector<T>& values) {
+        return WriteArray(values.data(), values.size());
+    }
+
+    // пишет строки и возвращает смещения массива смещений и блока байт
+    std::pair<uint64_t, uint64_t> WriteStrings(const std::vector<std::string_view>& strings);
+
+    void Finish(const SnapshotHeader& header);
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    uint64_t position_ = 0;
+
+    void Align();
+};
+
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const MappedFile& file);
+
+    const SnapshotHeader& GetHeader() const;
+
+    template <typename T>
+    const T* GetArray(uint64_t offset, uint64_t count) const;
+
+    std::vector<std::string_view> GetStrings(uint64_t count, uint64_t offsets, uint64_t bytes) const;
+
+private:
+    const MappedFile& file_;
+    const SnapshotHeader* header_;
+};
+
+template <typename T>
+uint64_t SnapshotWriter::WriteArray(const T* data, size_t count) {
+    Align();
+    const uint64_t offset = position_;
+    out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+    position_ += count * sizeof(T);
+    return offset;
+}
+
+template <typename T>
+const T* SnapshotReader::GetArray(uint64_t offset, uint64_t count) const {
+    if (offset % alignof(T) != 0 || offset > file_.size() || count > (file_.size() - offset) / sizeof(T)) {
+        throw std::runtime_error("Index snapshot is corrupted");
+    }
+    return reinterpret_cast<const T*>(file_.data() + offset);
+}
@@ -1,3 +1,4 @@
+#include "log_duration.h"
 #include "process_queries.h"
 #include "search_server.h"
 
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// массив, который либо владеет данными, либо смотрит в чужую память (отображённый файл снимка).
+// при первой модификации просматриваемые данные копируются в собственный вектор
+template <typename T>
+class MappableArray {
+public:
+    MappableArray() = default;
+
+    static MappableArray View(const T* data, size_t size) {
+        MappableArray result;
+        result.view_ = data;
+        result.view_size_ = size;
+        result.is_view_ = true;
+        return result;
+    }
+
+    const T* data() const {
+        return is_view_ ? view_ : owned_.data();
+    }
+
+    size_t size() const {
+        return is_view_ ? view_size_ : owned_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    const T* begin() const {
+        return data();
+    }
+
+    const T* end() const {
+        return data() + size();
+    }
+
+    void Assign(std::vector<T> values) {
+        owned_ = std::move(values);
+        view_ = nullptr;
+        view_size_ = 0;
+        is_view_ = false;
+    }
+
+    std::vector<T>& Mutable() {
+        if (is_view_) {
+            owned_.assign(view_, view_ + view_size_);
+            view_ = nullptr;
+            view_size_ = 0;
+            is_view_ = false;
+        }
+        return owned_;
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+    bool is_view_ = false;
+};
@@ -0,0 +1,206 @@
+#include "posting_list.h"
+
+PostingList PostingList::View(const DocumentSlot* slots, const double* term_freqs, size_t size, double max_term_freq) {
+    PostingList result;
+    result.slots_ = MappableArray<DocumentSlot>::View(slots, size);
+    result.term_freqs_ = MappableArray<double>::View(term_freqs, size);
+    result.sorted_size_ = result.live_size_ = size;
+    result.UpdateLogSize();
+    result.max_term_freq_ = max_term_freq;
+    return result;
+}
+
+void PostingList::Add(DocumentSlot slot, double term_freq) {
+    if (is_compressed_) {
+        Decompress();
+    }
+    const bool keeps_order = slots_.empty() || slots_[slots_.size() - 1] < slot;
+    slots_.Mutable().push_back(slot);
+    term_freqs_.Mutable().push_back(term_freq);
+    if (keeps_order && sorted_size_ + 1 == slots_.size()) {
+        ++sorted_size_;
+    }
+    ++live_size_;
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    UpdateLogSize();
+    CompactIfNeeded();
+}
+
+bool PostingList::Remove(DocumentSlot slot) {
+    if (is_compressed_) {
+        Decompress();
+    }
+    const size_t pos = Find(slot);
+    if (pos == slots_.size()) {
+        return false;
+    }
+    term_freqs_.Mutable()[pos] = TOMBSTONE;
+    --live_size_;
+    UpdateLogSize();
+    CompactIfNeeded();
+    return true;
+}
+
+void PostingList::MarkStale() {
+    --live_size_;
+    ++stale_size_;
+    UpdateLogSize();
+}
+
+void PostingList::RenumberSlots(const std::vector<DocumentSlot>& new_slots) {
+    const bool was_compressed = is_compressed_;
+    if (was_compressed) {
+        Decompress();
+    }
+    else if (sorted_size_ != slots_.size() || live_size_ + stale_size_ != slots_.size()) {
+        // надгробия и хвост могут ссылаться на слоты, которых больше нет
+        Compact();
+    }
+    for (DocumentSlot& slot : slots_.Mutable()) {
+        slot = new_slots[slot];
+    }
+    if (was_compressed) {
+        Compress();
+    }
+}
+
+size_t PostingList::GetStaleSize() const {
+    return stale_size_;
+}
+
+bool PostingList::Contains(DocumentSlot slot) const {
+    if (is_compressed_) {
+        const size_t block = compressed_.FindBlock(slot);
+        if (block == compressed_.GetBlockCount() || compressed_.GetBlockFirstSlot(block) > slot) {
+            return false;
+        }
+        std::array<DocumentSlot, POSTING_BLOCK_SIZE> block_slots;
+        std::array<double, POSTING_BLOCK_SIZE> block_term_freqs;
+        const size_t size = compressed_.DecodeBlock(block, block_slots.data(), block_term_freqs.data());
+        return std::binary_search(block_slots.begin(), block_slots.begin() + size, slot);
+    }
+    return Find(slot) != slots_.size();
+}
+
+size_t PostingList::size() const {
+    return live_size_;
+}
+
+bool PostingList::empty() const {
+    return live_size_ == 0;
+}
+
+double PostingList::GetLogSize() const {
+    return log_size_;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+bool PostingList::IsSorted() const {
+    return is_compressed_ || sorted_size_ == slots_.size();
+}
+
+void PostingList::Compress() {
+    if (is_compressed_) {
+        return;
+    }
+    if (sorted_size_ != slots_.size() || live_size_ + stale_size_ != slots_.size()) {
+        Compact();
+    }
+    compressed_ = CompressedPostings(slots_.data(), term_freqs_.data(), slots_.size());
+    slots_.Assign({});
+    term_freqs_.Assign({});
+    sorted_size_ = 0;
+    is_compressed_ = true;
+}
+
+bool PostingList::IsCompressed() const {
+    return is_compressed_;
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return sizeof(*this) - sizeof(compressed_) + compressed_.GetMemoryUsage()
+        + slots_.size() * sizeof(DocumentSlot) + term_freqs_.size() * sizeof(double);
+}
+
+void PostingList::Decompress() {
+    std::vector<DocumentSlot> slots;
+    std::vector<double> term_freqs;
+    slots.reserve(live_size_ + stale_size_);
+    term_freqs.reserve(live_size_ + stale_size_);
+    ForEach([&](DocumentSlot slot, double term_freq) {
+        slots.push_back(slot);
+        term_freqs.push_back(term_freq);
+    });
+    compressed_ = {};
+    is_compressed_ = false;
+    slots_.Assign(std::move(slots));
+    term_freqs_.Assign(std::move(term_freqs));
+    sorted_size_ = slots_.size();
+}
+
+void PostingList::UpdateLogSize() {
+    log_size_ = live_size_ == 0 ? -INFINITY : std::log(static_cast<double>(live_size_));
+}
+
+size_t PostingList::Find(DocumentSlot slot) const {
+    const DocumentSlot* slots = slots_.data();
+    const DocumentSlot* it = std::lower_bound(slots, slots + sorted_size_, slot);
+    if (it != slots + sorted_size_ && *it == slot && term_freqs_[it - slots] != TOMBSTONE) {
+        return it - slots;
+    }
+    for (size_t i = sorted_size_; i < slots_.size(); ++i) {
+        if (slots[i] == slot && term_freqs_[i] != TOMBSTONE) {
+            return i;
+        }
+    }
+    return slots_.size();
+}
+
+void PostingList::CompactIfNeeded() {
+    // несортированный хвост просматривается линейно, поэтому держим его коротким,
+    // а надгробия копим, пока их не станет столько же, сколько живых записей
+    const size_t unsorted = slots_.size() - sorted_size_;
+    const size_t dead = slots_.size() - live_size_ - stale_size_;
+    if (unsorted > 32 + sorted_size_ / 8 || dead > 32 + live_size_) {
+        Compact();
+    }
+}
+
+void PostingList::Compact() {
+    std::vector<std::pair<DocumentSlot, double>> tail;
+    for (size_t i = sorted_size_; i < slots_.size(); ++i) {
+        if (term_freqs_[i] != TOMBSTONE) {
+            tail.emplace_back(slots_[i], term_freqs_[i]);
+        }
+    }
+    std::sort(tail.begin(), tail.end());
+
+    std::vector<DocumentSlot> slots;
+    std::vector<double> term_freqs;
+    slots.reserve(live_size_ + stale_size_);
+    term_freqs.reserve(live_size_ + stale_size_);
+    auto tail_it = tail.begin();
+    for (size_t i = 0; i < sorted_size_; ++i) {
+        if (term_freqs_[i] == TOMBSTONE) {
+            continue;
+        }
+        for (; tail_it != tail.end() && tail_it->first < slots_[i]; ++tail_it) {
+            slots.push_back(tail_it->first);
+            term_freqs.push_back(tail_it->second);
+        }
+        slots.push_back(slots_[i]);
+        term_freqs.push_back(term_freqs_[i]);
+    }
+    for (; tail_it != tail.end(); ++tail_it) {
+        slots.push_back(tail_it->first);
+        term_freqs.push_back(tail_it->second);
+    }
+    max_term_freq_ = term_freqs.empty() ? 0.0 : *std::max_element(term_freqs.begin(), term_freqs.end());
+    slots_.Assign(std::move(slots));
+    term_freqs_.Assign(std::move(term_freqs));
+    sorted_size_ = slots_.size();
+    live_size_ = slots_.size() - stale_size_;
+}
@@ -0,0 +1,272 @@
+#pragma once
+#include "mappable_array.h"
+#include "compressed_postings.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// внутренний плотный номер документа в сервере
+using DocumentSlot = uint32_t;
+
+// список вхождений термина: отсортированные слоты документов и параллельный массив частот.
+// новые документы дописываются в хвост, удалённые помечаются надгробием,
+// а Compact() сливает хвост и выбрасывает надгробия. MarkStale() только уменьшает счётчик,
+// такие записи остаются в списке до PurgeStale() и отсеиваются вызывающим. Compress() переводит список в сжатые блоки,
+// первое изменение сжатого списка разворачивает его обратно
+class PostingList {
+public:
+    // проход по отсортированному списку в порядке слотов с пропуском вперёд, для динамического отсечения.
+    // годится только для IsSorted() списков
+    class Cursor {
+    public:
+        Cursor(const PostingList& postings, DocumentSlot first_slot, DocumentSlot last_slot)
+            : last_slot_(last_slot) {
+            if (postings.is_compressed_) {
+                compressed_ = &postings.compressed_;
+                LoadBlock(compressed_->FindBlock(first_slot), first_slot);
+                return;
+            }
+            slots_ = postings.slots_.data();
+            term_freqs_ = postings.term_freqs_.data();
+            pos_ = std::lower_bound(slots_, slots_ + postings.sorted_size_, first_slot) - slots_;
+            end_ = std::lower_bound(slots_ + pos_, slots_ + postings.sorted_size_, last_slot) - slots_;
+            SkipDead();
+        }
+
+        Cursor(const Cursor& other) {
+            *this = other;
+        }
+
+        // у сжатого списка указатели смотрят в собственный буфер раскодированного блока
+        Cursor& operator=(const Cursor& other) {
+            compressed_ = other.compressed_;
+            block_ = other.block_;
+            last_slot_ = other.last_slot_;
+            pos_ = other.pos_;
+            end_ = other.end_;
+            if (compressed_ != nullptr) {
+                block_slots_ = other.block_slots_;
+                block_term_freqs_ = other.block_term_freqs_;
+                slots_ = block_slots_.data();
+                term_freqs_ = block_term_freqs_.data();
+            }
+            else {
+                slots_ = other.slots_;
+                term_freqs_ = other.term_freqs_;
+            }
+            return *this;
+        }
+
+        bool AtEnd() const {
+            return pos_ == end_;
+        }
+
+        DocumentSlot Slot() const {
+            return slots_[pos_];
+        }
+
+        double TermFreq() const {
+            return term_freqs_[pos_];
+        }
+
+        void Next() {
+            ++pos_;
+            if (compressed_ == nullptr) {
+                SkipDead();
+            }
+            else if (pos_ == end_) {
+                LoadBlock(block_ + 1, 0);
+            }
+        }
+
+        // к первой живой записи со слотом не меньше slot: галопом, затем двоичным поиском
+        void SkipTo(DocumentSlot slot) {
+            if (AtEnd() || slots_[pos_] >= slot) {
+                return;
+            }
+            if (compressed_ != nullptr && slot > compressed_->GetBlockLastSlot(block_)) {
+                // нужный слот в одном из следующих блоков: промежуточные блоки не раскодируются
+                LoadBlock(compressed_->FindBlock(slot, block_ + 1), slot);
+                return;
+            }
+            size_t step = 1;
+            size_t low = pos_;
+            while (low + step < end_ && slots_[low + step] < slot) {
+                low += step;
+                step *= 2;
+            }
+            pos_ = std::lower_bound(slots_ + low + 1, slots_ + std::min(low + step + 1, end_), slot) - slots_;
+            SkipDead();
+        }
+
+    private:
+        const DocumentSlot* slots_ = nullptr;
+        const double* term_freqs_ = nullptr;
+        size_t pos_ = 0;
+        size_t end_ = 0;
+
+        const CompressedPostings* compressed_ = nullptr;
+        size_t block_ = 0;
+        DocumentSlot last_slot_ = 0;
+        std::array<DocumentSlot, POSTING_BLOCK_SIZE> block_slots_;
+        std::array<double, POSTING_BLOCK_SIZE> block_term_freqs_;
+
+        // в сжатом списке надгробий нет, курсор стоит на первом слоте блока не меньше first_slot
+        void LoadBlock(size_t block, DocumentSlot first_slot) {
+            block_ = block;
+            pos_ = end_ = 0;
+            if (block == compressed_->GetBlockCount() || compressed_->GetBlockFirstSlot(block) >= last_slot_) {
+                return;
+            }
+            const size_t size = compressed_->DecodeBlock(block, block_slots_.data(), block_term_freqs_.data());
+            slots_ = block_slots_.data();
+            term_freqs_ = block_term_freqs_.data();
+            pos_ = std::lower_bound(slots_, slots_ + size, first_slot) - slots_;
+            end_ = std::lower_bound(slots_ + pos_, slots_ + size, last_slot_) - slots_;
+        }
+
+        void SkipDead() {
+            while (pos_ != end_ && term_freqs_[pos_] == TOMBSTONE) {
+                ++pos_;
+            }
+        }
+    };
+
+    PostingList() = default;
+
+    // список поверх уже отсортированных массивов без надгробий, например из снимка индекса
+    static PostingList View(const DocumentSlot* slots, const double* term_freqs, size_t size, double max_term_freq);
+
+    void Add(DocumentSlot slot, double term_freq);
+    bool Remove(DocumentSlot slot);
+    // документ удалён без поиска записи: за O(1) меняются только size() и GetLogSize()
+    void MarkStale();
+    // выбрасывает записи, помеченные MarkStale(); is_stale(slot) узнаёт их по слоту
+    template <typename IsStale>
+    void PurgeStale(IsStale is_stale);
+    // заменяет каждый слот на new_slots[slot]; отображение возрастающее, так что порядок сохраняется.
+    // записи удалённых документов к этому моменту уже выброшены PurgeStale()
+    void RenumberSlots(const std::vector<DocumentSlot>& new_slots);
+    size_t GetStaleSize() const;
+    bool Contains(DocumentSlot slot) const;
+
+    size_t size() const;
+    bool empty() const;
+    // ln(size()), пересчитывается при каждом изменении числа вхождений: idf = ln(N) - GetLogSize()
+    double GetLogSize() const;
+    // не меньше частоты любого живого вхождения: растёт в Add, точно пересчитывается при уплотнении
+    double GetMaxTermFreq() const;
+    // нет несортированного хвоста, можно обходить Cursor
+    bool IsSorted() const;
+
+    void Compress();
+    bool IsCompressed() const;
+    size_t GetMemoryUsage() const;
+
+    template <typename Function>
+    void ForEach(Function function) const;
+
+    // только слоты из [first_slot, last_slot)
+    template <typename Function>
+    void ForEachInRange(DocumentSlot first_slot, DocumentSlot last_slot, Function function) const;
+
+private:
+    static constexpr double TOMBSTONE = -1.0;
+
+    MappableArray<DocumentSlot> slots_;
+    MappableArray<double> term_freqs_;
+    size_t sorted_size_ = 0;
+    size_t live_size_ = 0;
+    // записи удалённых документов, ещё лежащие в списке; не входят в live_size_
+    size_t stale_size_ = 0;
+    double log_size_ = -INFINITY;
+    double max_term_freq_ = 0.0;
+    CompressedPostings compressed_;
+    bool is_compressed_ = false;
+
+    size_t Find(DocumentSlot slot) const;
+    void Decompress();
+    void UpdateLogSize();
+    void CompactIfNeeded();
+    void Compact();
+};
+
+template <typename IsStale>
+void PostingList::PurgeStale(IsStale is_stale) {
+    if (stale_size_ == 0) {
+        return;
+    }
+    const bool was_compressed = is_compressed_;
+    if (was_compressed) {
+        Decompress();
+    }
+    double* term_freqs = term_freqs_.Mutable().data();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (term_freqs[i] != TOMBSTONE && is_stale(slots_[i])) {
+            term_freqs[i] = TOMBSTONE;
+        }
+    }
+    stale_size_ = 0;
+    Compact();
+    if (was_compressed) {
+        Compress();
+    }
+}
+
+template <typename Function>
+void PostingList::ForEach(Function function) const {
+    if (is_compressed_) {
+        std::array<DocumentSlot, POSTING_BLOCK_SIZE> block_slots;
+        std::array<double, POSTING_BLOCK_SIZE> block_term_freqs;
+        for (size_t block = 0; block < compressed_.GetBlockCount(); ++block) {
+            const size_t size = compressed_.DecodeBlock(block, block_slots.data(), block_term_freqs.data());
+            for (size_t i = 0; i < size; ++i) {
+                function(block_slots[i], block_term_freqs[i]);
+            }
+        }
+        return;
+    }
+    const DocumentSlot* slots = slots_.data();
+    const double* term_freqs = term_freqs_.data();
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        if (term_freqs[i] != TOMBSTONE) {
+            function(slots[i], term_freqs[i]);
+        }
+    }
+}
+
+template <typename Function>
+void PostingList::ForEachInRange(DocumentSlot first_slot, DocumentSlot last_slot, Function function) const {
+    if (is_compressed_) {
+        std::array<DocumentSlot, POSTING_BLOCK_SIZE> block_slots;
+        std::array<double, POSTING_BLOCK_SIZE> block_term_freqs;
+        for (size_t block = compressed_.FindBlock(first_slot);
+             block < compressed_.GetBlockCount() && compressed_.GetBlockFirstSlot(block) < last_slot; ++block) {
+            const size_t size = compressed_.DecodeBlock(block, block_slots.data(), block_term_freqs.data());
+            for (size_t i = 0; i < size; ++i) {
+                if (block_slots[i] >= first_slot && block_slots[i] < last_slot) {
+                    function(block_slots[i], block_term_freqs[i]);
+                }
+            }
+        }
+        return;
+    }
+    const DocumentSlot* slots = slots_.data();
+    const double* term_freqs = term_freqs_.data();
+    const size_t first = std::lower_bound(slots, slots + sorted_size_, first_slot) - slots;
+    const size_t last = std::lower_bound(slots + first, slots + sorted_size_, last_slot) - slots;
+    for (size_t i = first; i < last; ++i) {
+        if (term_freqs[i] != TOMBSTONE) {
+            function(slots[i], term_freqs[i]);
+        }
+    }
+    for (size_t i = sorted_size_; i < slots_.size(); ++i) {
+        if (slots[i] >= first_slot && slots[i] < last_slot && term_freqs[i] != TOMBSTONE) {
+            function(slots[i], term_freqs[i]);
+        }
+    }
+}
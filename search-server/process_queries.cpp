@@ -2,24 +2,201 @@
 
 #include <execution>
 #include <functional>
+#include <numeric>
 
+namespace {
+
+// запрос дороже своей доли работы одного рабочего делится на подзадачи по диапазонам слотов
+size_t GetSplitCost(size_t total_cost, const QueryExecutor& executor) {
+    const size_t min_split_cost = 1 << 16;
+    return std::max(min_split_cost, total_cost / (executor.GetWorkerCount() * 4));
+}
+
+std::vector<Document> FindTopDocumentsScheduled(const SearchServer& search_server, const std::string& query,
+                                                size_t cost, size_t split_cost, QueryExecutor& executor) {
+    if (cost >= split_cost) {
+        return search_server.FindTopDocuments(QueryExecutorPolicy{executor}, query);
+    }
+    return search_server.FindTopDocuments(query);
+}
+
+// вызывает process(index, cost, split_cost) для всех запросов, начиная с самых дорогих
+template <typename Process>
+void ForEachQueryByCost(const SearchServer& search_server, const std::vector<std::string>& queries,
+                        QueryExecutor& executor, Process process) {
+    // оценка разбирает запрос, поэтому тоже идёт задачами пула, а не в вызывающем потоке
+    std::vector<size_t> costs(queries.size());
+    executor.ParallelFor(queries.size(), [&](size_t index) {
+        costs[index] = search_server.EstimateQueryCost(queries[index]);
+    });
+    // самые дорогие запросы стартуют первыми, чтобы не остаться хвостом в конце пакета
+    std::vector<size_t> order(queries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) { return costs[lhs] > costs[rhs]; });
+    const size_t split_cost = GetSplitCost(std::accumulate(costs.begin(), costs.end(), size_t{0}), executor);
+    executor.ParallelFor(order.size(), [&](size_t position) {
+        const size_t index = order[position];
+        process(index, costs[index], split_cost);
+    });
+}
+
+}  // namespace
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
+    return ProcessQueries(search_server, queries, GetDefaultQueryExecutor());
+}
+
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryExecutor& executor){
     std::vector<std::vector<Document>> results(queries.size());
-    transform(std::execution::par, queries.begin(), queries.end(), results.begin(),
-              [&search_server](const auto& query) { return search_server.FindTopDocuments(query); });
+    ForEachQueryByCost(search_server, queries, executor, [&](size_t index, size_t cost, size_t split_cost) {
+        results[index] = FindTopDocumentsScheduled(search_server, queries[index], cost, split_cost, executor);
+    });
     return results;
 }
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
-    std::vector<std::vector<Document>> results = ProcessQueries(search_server,queries);
-    std::vector<Document> documents;
-    for (auto const& document : results){
-        documents.insert(documents.end(), document.begin(), document.end());
+    return ProcessQueriesJoined(search_server, queries, GetDefaultQueryExecutor());
+}
+
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryExecutor& executor){
+    // у каждого запроса своё окно из K документов, после выполнения окна сдвигаются к началу
+    const size_t max_count = search_server.GetMaxResultDocumentCount();
+    std::vector<Document> documents(max_count * queries.size());
+    std::vector<size_t> sizes(queries.size());
+    ForEachQueryByCost(search_server, queries, executor, [&](size_t index, size_t cost, size_t split_cost) {
+        const auto result = FindTopDocumentsScheduled(search_server, queries[index], cost, split_cost, executor);
+        std::copy(result.begin(), result.end(), documents.begin() + index * max_count);
+        sizes[index] = result.size();
+    });
+    size_t size = 0;
+    for (size_t index = 0; index < queries.size(); ++index) {
+        const auto window = documents.begin() + index * max_count;
+        size = std::move(window, window + sizes[index], documents.begin() + size) - documents.begin();
     }
+    documents.resize(size);
     return documents;
 }
+
+JoinedQueryResults::Iterator::Iterator(JoinedQueryResults* results, size_t query)
+    : results_(results)
+    , query_(query) {
+    SkipEmptyQueries();
+}
+
+JoinedQueryResults::Iterator::reference JoinedQueryResults::Iterator::operator*() const {
+    return results_->buffer_[query_ * results_->max_count_ + position_];
+}
+
+JoinedQueryResults::Iterator::pointer JoinedQueryResults::Iterator::operator->() const {
+    return &**this;
+}
+
+JoinedQueryResults::Iterator& JoinedQueryResults::Iterator::operator++() {
+    ++position_;
+    SkipEmptyQueries();
+    return *this;
+}
+
+bool JoinedQueryResults::Iterator::operator==(const Iterator& other) const {
+    return query_ == other.query_ && position_ == other.position_;
+}
+
+bool JoinedQueryResults::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+void JoinedQueryResults::Iterator::SkipEmptyQueries() {
+    const size_t query_count = results_->queries_.size();
+    while (query_ < query_count) {
+        results_->WaitFor(query_);
+        if (position_ < results_->sizes_[query_]) {
+            return;
+        }
+        ++query_;
+        position_ = 0;
+    }
+}
+
+JoinedQueryResults::JoinedQueryResults(const SearchServer& search_server, const std::vector<std::string>& queries,
+                                       QueryExecutor& executor)
+    : search_server_(search_server)
+    , queries_(queries)
+    , max_count_(search_server.GetMaxResultDocumentCount())
+    , buffer_(std::make_unique<Document[]>(max_count_ * queries.size()))
+    , sizes_(std::make_unique<size_t[]>(queries.size()))
+    , states_(std::make_unique<std::atomic<uint8_t>[]>(queries.size()))
+    , errors_(queries.size()) {
+    for (size_t query = 0; query < queries.size(); ++query) {
+        states_[query].store(PENDING, std::memory_order_relaxed);
+    }
+    // запросы отправляются по порядку небольшими кусками, чтобы первые результаты были готовы первыми
+    const size_t chunk_size = 16;
+    for (size_t first = 0; first < queries.size(); first += chunk_size) {
+        const size_t last = std::min(first + chunk_size, queries.size());
+        {
+            std::lock_guard guard(mutex_);
+            ++running_tasks_;
+        }
+        executor.Submit([this, first, last, &executor] {
+            ProcessChunk(first, last, executor);
+        });
+    }
+}
+
+JoinedQueryResults::~JoinedQueryResults() {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [this] {
+        return running_tasks_ == 0;
+    });
+}
+
+JoinedQueryResults::Iterator JoinedQueryResults::begin() {
+    return Iterator(this, 0);
+}
+
+JoinedQueryResults::Iterator JoinedQueryResults::end() {
+    return Iterator(this, queries_.size());
+}
+
+void JoinedQueryResults::ProcessChunk(size_t first, size_t last, QueryExecutor& executor) {
+    for (size_t query = first; query < last; ++query) {
+        try {
+            const size_t cost = search_server_.EstimateQueryCost(queries_[query]);
+            const auto result = FindTopDocumentsScheduled(search_server_, queries_[query], cost, GetSplitCost(0, executor), executor);
+            std::copy(result.begin(), result.end(), buffer_.get() + query * max_count_);
+            sizes_[query] = result.size();
+            states_[query].store(READY, std::memory_order_release);
+        }
+        catch (...) {
+            errors_[query] = std::current_exception();
+            states_[query].store(FAILED, std::memory_order_release);
+        }
+        std::lock_guard guard(mutex_);
+        changed_.notify_all();
+    }
+    std::lock_guard guard(mutex_);
+    --running_tasks_;
+    changed_.notify_all();
+}
+
+void JoinedQueryResults::WaitFor(size_t query) {
+    if (states_[query].load(std::memory_order_acquire) == PENDING) {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [this, query] {
+            return states_[query].load(std::memory_order_acquire) != PENDING;
+        });
+    }
+    if (states_[query].load(std::memory_order_acquire) == FAILED) {
+        std::rethrow_exception(errors_[query]);
+    }
+}
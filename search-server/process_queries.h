@@ -1,15 +1,98 @@
 #pragma once
 #include "document.h"
 #include "search_server.h"
+#include "query_executor.h"
 #include <vector>
 #include <list>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+// запросы выполняются задачами executor начиная с самых дорогих, тяжёлые делятся на диапазоны слотов
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryExecutor& executor);
+
+// результаты пишутся сразу в один буфер на K * queries.size() документов, который затем уплотняется
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries);
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryExecutor& executor);
+
+// потоковый вариант ProcessQueriesJoined: запросы стартуют в конструкторе, а итератор отдаёт документы
+// в порядке запросов, дожидаясь только очередного запроса. search_server и queries должны жить,
+// пока жив объект; обходить результаты из задач того же executor нельзя
+class JoinedQueryResults {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Document;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Document*;
+        using reference = const Document&;
+
+        Iterator(JoinedQueryResults* results, size_t query);
+
+        reference operator*() const;
+        pointer operator->() const;
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const;
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        JoinedQueryResults* results_;
+        size_t query_;
+        size_t position_ = 0;
+
+        void SkipEmptyQueries();
+    };
+
+    JoinedQueryResults(const SearchServer& search_server, const std::vector<std::string>& queries,
+                       QueryExecutor& executor = GetDefaultQueryExecutor());
+    // дожидается запущенных задач, даже если результаты не дочитаны
+    ~JoinedQueryResults();
+
+    JoinedQueryResults(const JoinedQueryResults&) = delete;
+    JoinedQueryResults& operator=(const JoinedQueryResults&) = delete;
+
+    // begin() можно вызвать один раз: это однопроходный диапазон
+    Iterator begin();
+    Iterator end();
+
+private:
+    enum QueryState : uint8_t {
+        PENDING,
+        READY,
+        FAILED,
+    };
+
+    const SearchServer& search_server_;
+    const std::vector<std::string>& queries_;
+    size_t max_count_;
+    std::unique_ptr<Document[]> buffer_;
+    std::unique_ptr<size_t[]> sizes_;
+    std::unique_ptr<std::atomic<uint8_t>[]> states_;
+    std::vector<std::exception_ptr> errors_;
+    size_t running_tasks_ = 0;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+
+    void ProcessChunk(size_t first, size_t last, QueryExecutor& executor);
+    // ждёт запрос и пробрасывает его исключение
+    void WaitFor(size_t query);
+};
\ No newline at end of file
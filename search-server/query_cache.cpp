@@ -0,0 +1,77 @@
+#include "query_cache.h"
+
+#include <algorithm>
+
+bool QueryCacheKey::operator==(const QueryCacheKey& other) const {
+    return status == other.status && max_count == other.max_count
+        && plus_terms == other.plus_terms && minus_terms == other.minus_terms;
+}
+
+size_t QueryCacheKeyHasher::operator()(const QueryCacheKey& key) const {
+    uint64_t hash = static_cast<uint64_t>(key.status) * 31 + key.max_count;
+    const auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x100000001b3ULL;
+    };
+    for (const TermId term_id : key.plus_terms) {
+        mix(term_id);
+    }
+    // разделитель, чтобы плюс- и минус-слова с одинаковыми id давали разный хэш
+    mix(UINT64_MAX);
+    for (const TermId term_id : key.minus_terms) {
+        mix(term_id);
+    }
+    return static_cast<size_t>(hash ^ (hash >> 29));
+}
+
+QueryCache::QueryCache(size_t capacity)
+    : shard_capacity_(std::max<size_t>(1, (capacity + SHARD_COUNT - 1) / SHARD_COUNT))
+    , shards_(SHARD_COUNT) {
+}
+
+std::optional<std::vector<Document>> QueryCache::Find(const QueryCacheKey& key, uint64_t epoch) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    if (it->second.epoch != epoch) {
+        shard.recency.erase(it->second.position);
+        shard.entries.erase(it);
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    shard.recency.splice(shard.recency.begin(), shard.recency, it->second.position);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second.documents;
+}
+
+void QueryCache::Insert(QueryCacheKey key, uint64_t epoch, std::vector<Document> documents) {
+    Shard& shard = GetShard(key);
+    std::lock_guard guard(shard.mutex);
+    const auto [it, inserted] = shard.entries.try_emplace(std::move(key));
+    Entry& entry = it->second;
+    entry.epoch = epoch;
+    entry.documents = std::move(documents);
+    if (!inserted) {
+        shard.recency.splice(shard.recency.begin(), shard.recency, entry.position);
+        return;
+    }
+    // узлы unordered_map не переезжают при рехэше, поэтому указатель на ключ стабилен
+    shard.recency.push_front(&it->first);
+    entry.position = shard.recency.begin();
+    if (shard.entries.size() > shard_capacity_) {
+        const QueryCacheKey* oldest = shard.recency.back();
+        shard.recency.pop_back();
+        shard.entries.erase(shard.entries.find(*oldest));
+    }
+}
+
+QueryCacheStats QueryCache::GetStats() const {
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed)};
+}
+
+QueryCache::Shard& QueryCache::GetShard(const QueryCacheKey& key) {
+    return shards_[QueryCacheKeyHasher{}(key) % SHARD_COUNT];
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "document.h"
+#include "term_dictionary.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// нормализованный запрос: отсортированные id плюс- и минус-слов без повторов, фильтр статуса и K
+struct QueryCacheKey {
+    std::vector<TermId> plus_terms;
+    std::vector<TermId> minus_terms;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    size_t max_count = 0;
+
+    bool operator==(const QueryCacheKey& other) const;
+};
+
+struct QueryCacheKeyHasher {
+    size_t operator()(const QueryCacheKey& key) const;
+};
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// LRU-кэш результатов поиска, поделённый на шарды со своими мьютексами.
+// запись хранит эпоху индекса, при которой посчитана, и с другой эпохой считается промахом
+class QueryCache {
+public:
+    explicit QueryCache(size_t capacity);
+
+    std::optional<std::vector<Document>> Find(const QueryCacheKey& key, uint64_t epoch);
+    void Insert(QueryCacheKey key, uint64_t epoch, std::vector<Document> documents);
+
+    QueryCacheStats GetStats() const;
+
+private:
+    static constexpr size_t SHARD_COUNT = 16;
+
+    struct Entry {
+        uint64_t epoch = 0;
+        std::vector<Document> documents;
+        std::list<const QueryCacheKey*>::iterator position;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // от недавно использованных к давним, указатели смотрят на ключи узлов entries
+        std::list<const QueryCacheKey*> recency;
+        std::unordered_map<QueryCacheKey, Entry, QueryCacheKeyHasher> entries;
+    };
+
+    size_t shard_capacity_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard& GetShard(const QueryCacheKey& key);
+};
@@ -0,0 +1,114 @@
+#include "query_dispatcher.h"
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+QueryDispatcher::QueryDispatcher(const SearchServer& search_server, QueryExecutor& executor, size_t max_batch_size)
+    : search_server_(search_server)
+    , executor_(executor)
+    , max_batch_size_(std::max<size_t>(1, max_batch_size)) {
+}
+
+QueryDispatcher::~QueryDispatcher() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] {
+        return !draining_;
+    });
+}
+
+std::future<std::vector<Document>> QueryDispatcher::SubmitQuery(std::string raw_query, QueryOptions options) {
+    auto promise = std::make_shared<std::promise<std::vector<Document>>>();
+    auto result = promise->get_future();
+    SubmitQuery(std::move(raw_query), options, [promise](std::vector<Document> documents, std::exception_ptr error) {
+        if (error) {
+            promise->set_exception(error);
+        }
+        else {
+            promise->set_value(std::move(documents));
+        }
+    });
+    return result;
+}
+
+void QueryDispatcher::SubmitQuery(std::string raw_query, QueryOptions options, Callback callback) {
+    {
+        std::lock_guard guard(mutex_);
+        pending_.push_back({std::move(raw_query), options, std::move(callback)});
+        if (draining_) {
+            return;
+        }
+        draining_ = true;
+    }
+    // пустая очередь не ждёт добора пакета: одиночный запрос уходит сразу,
+    // а пакеты складываются сами из запросов, пришедших пока выполнялся предыдущий
+    executor_.Submit([this] {
+        DrainBatch();
+    });
+}
+
+void QueryDispatcher::DrainBatch() {
+    std::vector<Request> batch;
+    {
+        std::lock_guard guard(mutex_);
+        if (pending_.size() <= max_batch_size_) {
+            batch.swap(pending_);
+        }
+        else {
+            batch.assign(std::make_move_iterator(pending_.begin()), std::make_move_iterator(pending_.begin() + max_batch_size_));
+            pending_.erase(pending_.begin(), pending_.begin() + max_batch_size_);
+        }
+    }
+
+    // одинаковые запросы стоят рядом, каждый разбирается и выполняется один раз
+    std::vector<size_t> order(batch.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&batch](size_t lhs, size_t rhs) {
+        return std::tie(batch[lhs].options.status, batch[lhs].raw_query)
+            < std::tie(batch[rhs].options.status, batch[rhs].raw_query);
+    });
+    std::vector<size_t> group_starts;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Request& request = batch[order[i]];
+        if (i == 0 || request.options.status != batch[order[i - 1]].options.status
+            || request.raw_query != batch[order[i - 1]].raw_query) {
+            group_starts.push_back(i);
+        }
+    }
+    group_starts.push_back(order.size());
+
+    const size_t group_count = group_starts.size() - 1;
+    std::vector<std::vector<Document>> results(group_count);
+    std::vector<std::exception_ptr> errors(group_count);
+    executor_.ParallelFor(group_count, [&](size_t group) {
+        const Request& request = batch[order[group_starts[group]]];
+        try {
+            results[group] = search_server_.FindTopDocuments(request.raw_query, request.options.status);
+        }
+        catch (...) {
+            errors[group] = std::current_exception();
+        }
+    });
+    for (size_t group = 0; group < group_count; ++group) {
+        for (size_t i = group_starts[group]; i < group_starts[group + 1]; ++i) {
+            Request& request = batch[order[i]];
+            if (i + 1 == group_starts[group + 1]) {
+                request.callback(std::move(results[group]), errors[group]);
+            }
+            else {
+                request.callback(results[group], errors[group]);
+            }
+        }
+    }
+
+    std::lock_guard guard(mutex_);
+    if (pending_.empty()) {
+        draining_ = false;
+        idle_.notify_all();
+        return;
+    }
+    // следующий пакет отдельной задачей, чтобы не занимать рабочего непрерывно
+    executor_.Submit([this] {
+        DrainBatch();
+    });
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "document.h"
+#include "search_server.h"
+#include "query_executor.h"
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct QueryOptions {
+    DocumentStatus status = DocumentStatus::ACTUAL;
+};
+
+// асинхронный вход для FindTopDocuments: запросы из разных потоков копятся в общей очереди
+// и разбираются пакетами задачами executor. одинаковые запросы пакета выполняются один раз.
+// search_server не должен меняться, пока в диспетчере есть запросы
+class QueryDispatcher {
+public:
+    // колбэк получает либо документы, либо исключение запроса; бросать из него нельзя
+    using Callback = std::function<void(std::vector<Document> documents, std::exception_ptr error)>;
+
+    explicit QueryDispatcher(const SearchServer& search_server, QueryExecutor& executor = GetDefaultQueryExecutor(),
+                             size_t max_batch_size = 256);
+    // дожидается выполнения всех принятых запросов
+    ~QueryDispatcher();
+
+    QueryDispatcher(const QueryDispatcher&) = delete;
+    QueryDispatcher& operator=(const QueryDispatcher&) = delete;
+
+    std::future<std::vector<Document>> SubmitQuery(std::string raw_query, QueryOptions options = {});
+    void SubmitQuery(std::string raw_query, QueryOptions options, Callback callback);
+
+private:
+    struct Request {
+        std::string raw_query;
+        QueryOptions options;
+        Callback callback;
+    };
+
+    const SearchServer& search_server_;
+    QueryExecutor& executor_;
+    size_t max_batch_size_;
+    std::mutex mutex_;
+    std::condition_variable idle_;
+    std::vector<Request> pending_;
+    // в executor есть задача разбора очереди; пока она есть, новые запросы только дописываются
+    bool draining_ = false;
+
+    void DrainBatch();
+};
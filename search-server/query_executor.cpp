@@ -0,0 +1,123 @@
+#include "query_executor.h"
+
+thread_local QueryExecutor* QueryExecutor::current_executor_ = nullptr;
+thread_local size_t QueryExecutor::current_worker_ = 0;
+
+QueryExecutor& GetDefaultQueryExecutor() {
+    static QueryExecutor executor;
+    return executor;
+}
+
+QueryExecutor::QueryExecutor(size_t worker_count) {
+    worker_count = std::max<size_t>(1, worker_count);
+    for (size_t worker = 0; worker < worker_count; ++worker) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t worker = 0; worker < worker_count; ++worker) {
+        workers_.emplace_back([this, worker] {
+            WorkerLoop(worker);
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    {
+        std::lock_guard guard(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t QueryExecutor::GetWorkerCount() const {
+    return workers_.size();
+}
+
+void QueryExecutor::Submit(std::function<void()> task) {
+    if (current_executor_ == this) {
+        Push(current_worker_, std::move(task));
+    }
+    else {
+        // владелец снимает задачи с конца, поэтому внешние кладутся в начало
+        Push(next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size(), std::move(task), true);
+    }
+}
+
+void QueryExecutor::Push(size_t worker, std::function<void()> task, bool to_front) {
+    {
+        std::lock_guard guard(queues_[worker]->mutex);
+        if (to_front) {
+            queues_[worker]->tasks.push_front(std::move(task));
+        }
+        else {
+            queues_[worker]->tasks.push_back(std::move(task));
+        }
+    }
+    queued_.fetch_add(1, std::memory_order_release);
+    // под мьютексом сна, чтобы уснувший после проверки queued_ рабочий не пропустил сигнал
+    std::lock_guard guard(sleep_mutex_);
+    wake_.notify_one();
+}
+
+void QueryExecutor::Wait(Batch& batch) {
+    const auto is_done = [&batch] {
+        return batch.remaining.load(std::memory_order_acquire) == 0;
+    };
+    if (current_executor_ == this) {
+        // рабочий не может сразу уснуть: его подзадачи могут лежать в его же деке. когда задач
+        // нет ни в одной деке, оставшиеся задачи пакета уже выполняют другие, и можно ждать их
+        while (!is_done()) {
+            if (!TryRunOne(current_worker_)) {
+                std::unique_lock lock(batch.mutex);
+                batch.done.wait(lock, is_done);
+            }
+        }
+        return;
+    }
+    std::unique_lock lock(batch.mutex);
+    batch.done.wait(lock, is_done);
+}
+
+bool QueryExecutor::TryRunOne(size_t worker) {
+    std::function<void()> task;
+    for (size_t i = 0; i < queues_.size() && !task; ++i) {
+        WorkQueue& queue = *queues_[(worker + i) % queues_.size()];
+        std::lock_guard guard(queue.mutex);
+        if (queue.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void QueryExecutor::WorkerLoop(size_t worker) {
+    current_executor_ = this;
+    current_worker_ = worker;
+    while (true) {
+        if (TryRunOne(worker)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <execution>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// пул потоков для запросов: у каждого рабочего своя дека задач, свободные рабочие крадут из чужих.
+// вложенный ParallelFor из задачи кладёт подзадачи в деку своего рабочего и помогает их выполнять,
+// поэтому вложенный параллелизм не плодит потоков сверх worker_count
+class QueryExecutor {
+public:
+    explicit QueryExecutor(size_t worker_count = std::thread::hardware_concurrency());
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    size_t GetWorkerCount() const;
+
+    // task(i) для i из [0, count); задачи с меньшим i начинают выполняться раньше.
+    // первое исключение из задач пробрасывается после завершения всех
+    template <typename Task>
+    void ParallelFor(size_t count, Task task);
+
+    // задача без ожидания результата. снаружи пула задачи расходятся по декам по кругу
+    // и выполняются в порядке отправки, из рабочего потока - кладутся в его деку
+    void Submit(std::function<void()> task);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    struct Batch {
+        std::atomic<size_t> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+
+    static thread_local QueryExecutor* current_executor_;
+    static thread_local size_t current_worker_;
+
+    void Push(size_t worker, std::function<void()> task, bool to_front = false);
+    // до завершения всех задач пакета; рабочий тем временем выполняет задачи из дек
+    void Wait(Batch& batch);
+    // своя дека с конца, чужие - с начала
+    bool TryRunOne(size_t worker);
+    void WorkerLoop(size_t worker);
+};
+
+// общий пул на hardware_concurrency() рабочих, создаётся при первом обращении
+QueryExecutor& GetDefaultQueryExecutor();
+
+// политика выполнения для шаблонов SearchServer: параллельные циклы идут задачами пула
+struct QueryExecutorPolicy {
+    QueryExecutor& executor;
+};
+
+// число кусков, на которые имеет смысл делить работу при данной политике
+template <typename ExecutionPolicy>
+size_t GetParallelism(const ExecutionPolicy&) {
+    return std::thread::hardware_concurrency();
+}
+
+inline size_t GetParallelism(const QueryExecutorPolicy& policy) {
+    return policy.executor.GetWorkerCount();
+}
+
+// function(i) для i из [0, count) по правилам политики
+template <typename ExecutionPolicy, typename Function>
+void ForEachIndex(const ExecutionPolicy& policy, size_t count, Function function) {
+    if constexpr (std::is_same_v<ExecutionPolicy, QueryExecutorPolicy>) {
+        policy.executor.ParallelFor(count, function);
+    }
+    else {
+        std::vector<size_t> indexes(count);
+        std::iota(indexes.begin(), indexes.end(), 0);
+        std::for_each(policy, indexes.begin(), indexes.end(), function);
+    }
+}
+
+template <typename Task>
+void QueryExecutor::ParallelFor(size_t count, Task task) {
+    if (count == 0) {
+        return;
+    }
+    auto batch = std::make_shared<Batch>();
+    batch->remaining = count;
+    const bool is_worker = current_executor_ == this;
+    // кладём с конца, чтобы владелец деки, снимающий задачи с конца, шёл по возрастанию i
+    size_t pushed = 0;
+    try {
+        for (; pushed < count; ++pushed) {
+            const size_t i = count - 1 - pushed;
+            Push(is_worker ? current_worker_ : i % queues_.size(), [batch, &task, i] {
+                try {
+                    task(i);
+                }
+                catch (...) {
+                    std::lock_guard guard(batch->mutex);
+                    if (!batch->error) {
+                        batch->error = std::current_exception();
+                    }
+                }
+                if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard guard(batch->mutex);
+                    batch->done.notify_all();
+                }
+            });
+        }
+    }
+    catch (...) {
+        // разосланные задачи ссылаются на task, поэтому выходить можно только после них
+        batch->remaining.fetch_sub(count - pushed, std::memory_order_acq_rel);
+        Wait(*batch);
+        throw;
+    }
+    Wait(*batch);
+    if (batch->error) {
+        std::rethrow_exception(batch->error);
+    }
+}
@@ -1,25 +1,216 @@
 #include "remove_duplicates.h"
 
+#include <numeric>
+
+namespace {
+
+uint64_t MixHash(uint64_t value) {
+    // финализатор splitmix64
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+uint64_t HashTerms(const MappableArray<TermId>& terms) {
+    uint64_t hash = MixHash(terms.size());
+    for (const TermId term_id : terms) {
+        hash = MixHash(hash ^ term_id);
+    }
+    return hash;
+}
+
+double ComputeJaccard(const MappableArray<TermId>& lhs, const MappableArray<TermId>& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < lhs.size() && j < rhs.size();) {
+        if (lhs[i] < rhs[j]) {
+            ++i;
+        }
+        else if (rhs[j] < lhs[i]) {
+            ++j;
+        }
+        else {
+            ++common;
+            ++i;
+            ++j;
+        }
+    }
+    return static_cast<double>(common) / static_cast<double>(lhs.size() + rhs.size() - common);
+}
+
+// система непересекающихся множеств, корень группы - документ с меньшим индексом (и id)
+class DocumentGroups {
+public:
+    explicit DocumentGroups(size_t size)
+        : parents_(size) {
+        std::iota(parents_.begin(), parents_.end(), 0);
+    }
+
+    size_t Find(size_t index) {
+        while (parents_[index] != index) {
+            parents_[index] = parents_[parents_[index]];
+            index = parents_[index];
+        }
+        return index;
+    }
+
+    void Unite(size_t lhs, size_t rhs) {
+        lhs = Find(lhs);
+        rhs = Find(rhs);
+        if (lhs != rhs) {
+            parents_[std::max(lhs, rhs)] = std::min(lhs, rhs);
+        }
+    }
+
+private:
+    std::vector<size_t> parents_;
+};
+
+// в отсортированных по (ключ, индекс) парах документы с одинаковым ключом объединяются, если равны.
+// равенство транзитивно, поэтому документ сравнивается только с представителями уже найденных
+// в корзине групп: сравнений не n^2, а n на число групп корзины
+template <typename Equal>
+void UniteEqualKeys(const std::vector<std::pair<uint64_t, size_t>>& keys, DocumentGroups& groups, Equal equal) {
+    std::vector<size_t> representatives;
+    for (size_t first = 0; first < keys.size();) {
+        size_t last = first + 1;
+        while (last < keys.size() && keys[last].first == keys[first].first) {
+            ++last;
+        }
+        representatives.clear();
+        for (size_t i = first; i < last; ++i) {
+            const size_t index = keys[i].second;
+            const auto representative = std::find_if(representatives.begin(), representatives.end(),
+                [&](size_t representative) { return equal(representative, index); });
+            if (representative != representatives.end()) {
+                groups.Unite(*representative, index);
+            }
+            else {
+                representatives.push_back(index);
+            }
+        }
+        first = last;
+    }
+}
+
+template <typename ExecutionPolicy>
+std::vector<int> FindDuplicatesImpl(const ExecutionPolicy& policy, const SearchServer& search_server,
+                                    const DuplicateSearchOptions& options) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<const MappableArray<TermId>*> document_terms(document_ids.size());
+    std::transform(document_ids.begin(), document_ids.end(), document_terms.begin(), [&search_server](int document_id) {
+        return &search_server.GetDocumentTerms(document_id);
+    });
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    DocumentGroups groups(document_ids.size());
+    std::vector<std::pair<uint64_t, size_t>> keys(document_ids.size());
+
+    std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+        keys[index] = {HashTerms(*document_terms[index]), index};
+    });
+    std::sort(policy, keys.begin(), keys.end());
+    UniteEqualKeys(keys, groups, [&](size_t lhs, size_t rhs) {
+        const auto& lhs_terms = *document_terms[lhs];
+        const auto& rhs_terms = *document_terms[rhs];
+        return std::equal(lhs_terms.begin(), lhs_terms.end(), rhs_terms.begin(), rhs_terms.end());
+    });
+
+    if (options.near_duplicates) {
+        // подписи не хранятся: полоса за полосой считаются её rows_per_band минимумов и хэш от них,
+        // документ получает номер своей корзины в полосе
+        const size_t document_count = document_ids.size();
+        const size_t rows_per_band = std::max<size_t>(1, options.rows_per_band);
+        std::vector<uint32_t> buckets(options.band_count * document_count);
+        for (size_t band = 0; band < options.band_count; ++band) {
+            std::for_each(policy, indexes.begin(), indexes.end(), [&](size_t index) {
+                uint64_t band_hash = MixHash(band);
+                for (size_t row = 0; row < rows_per_band; ++row) {
+                    const uint64_t seed = MixHash(band * rows_per_band + row + 1);
+                    uint64_t min_hash = UINT64_MAX;
+                    for (const TermId term_id : *document_terms[index]) {
+                        min_hash = std::min(min_hash, MixHash(seed ^ term_id));
+                    }
+                    band_hash = MixHash(band_hash ^ min_hash);
+                }
+                keys[index] = {band_hash, index};
+            });
+            std::sort(policy, keys.begin(), keys.end());
+            uint32_t bucket = 0;
+            for (size_t i = 0; i < keys.size(); ++i) {
+                if (i > 0 && keys[i].first != keys[i - 1].first) {
+                    ++bucket;
+                }
+                buckets[band * document_count + keys[i].second] = bucket;
+            }
+        }
+
+        // документы идут по возрастанию id: документ - дубликат, если похож на один из уже оставленных
+        // документов с общей корзиной, иначе он остаётся сам. сравнение только с оставленным документом
+        // группы не даёт склеить цепочку, где похожи лишь соседи
+        const uint32_t NONE = UINT32_MAX;
+        std::vector<uint32_t> last_kept(buckets.size(), NONE);
+        std::vector<uint32_t> previous_kept(buckets.size(), NONE);
+        std::vector<uint32_t> compared_with(document_count, NONE);
+        for (size_t index = 0; index < document_count; ++index) {
+            if (groups.Find(index) != index) {
+                continue;
+            }
+            uint32_t kept = NONE;
+            for (size_t band = 0; band < options.band_count && kept == NONE; ++band) {
+                const size_t bucket = band * document_count + buckets[band * document_count + index];
+                for (uint32_t candidate = last_kept[bucket]; candidate != NONE;
+                     candidate = previous_kept[band * document_count + candidate]) {
+                    if (compared_with[candidate] == index) {
+                        continue;
+                    }
+                    compared_with[candidate] = static_cast<uint32_t>(index);
+                    const double similarity = ComputeJaccard(*document_terms[candidate], *document_terms[index]);
+                    if (similarity >= options.similarity_threshold) {
+                        kept = candidate;
+                        break;
+                    }
+                }
+            }
+            if (kept != NONE) {
+                groups.Unite(kept, index);
+                continue;
+            }
+            for (size_t band = 0; band < options.band_count; ++band) {
+                const size_t bucket = band * document_count + buckets[band * document_count + index];
+                previous_kept[band * document_count + index] = last_kept[bucket];
+                last_kept[bucket] = static_cast<uint32_t>(index);
+            }
+        }
+    }
+
+    std::vector<int> duplicates;
+    for (size_t index = 0; index < document_ids.size(); ++index) {
+        if (groups.Find(index) != index) {
+            duplicates.push_back(document_ids[index]);
+        }
+    }
+    return duplicates;
+}
+
+}  // namespace
+
+std::vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options) {
+    return FindDuplicatesImpl(std::execution::seq, search_server, options);
+}
+
+std::vector<int> FindDuplicates(const std::execution::parallel_policy& policy, const SearchServer& search_server,
+                                const DuplicateSearchOptions& options) {
+    return FindDuplicatesImpl(policy, search_server, options);
+}
+
 //вне класса сервера функция удаления дубликатов - реализация
 void RemoveDuplicates(SearchServer& search_server){
-    
-    // будем формировать пары с id и набором слов документа
-    std::vector<std::vector<std::string>> docs_struct;
-    
-    for (const int document_id : search_server){
-        std::vector<std::string> key_words;
-        std::map<std::string, double> id_freq = search_server.GetWordFrequencies(document_id);
-        std::transform(id_freq.begin(), id_freq.end(), std::back_inserter(key_words), [](std::pair<std::string, double> word) { return word.first;});
-        docs_struct.push_back(key_words);    
-    }
-   
-    for (auto i = 0; i < docs_struct.size(); ++i){
-        auto it = find(docs_struct.begin() + i + 1,docs_struct.end(), docs_struct[i]);
-        if (it != docs_struct.end()){
-            int id = distance(docs_struct.begin(), it) + 1;
-            std::cout << "Found duplicate document id "s << id << std::endl;
-            search_server.RemoveDocument(id);
-            
-        }
+    for (const int id : FindDuplicates(std::execution::par, search_server)) {
+        std::cout << "Found duplicate document id "s << id << std::endl;
+        search_server.RemoveDocument(id);
     }
 }
\ No newline at end of file
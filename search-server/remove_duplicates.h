@@ -1,6 +1,24 @@
 #pragma once
 #include <algorithm>
+#include <execution>
 #include <iostream>
 #include "search_server.h"
 
+struct DuplicateSearchOptions {
+    // кроме точных совпадений набора слов искать документы с мерой Жаккара наборов не ниже порога
+    bool near_duplicates = false;
+    double similarity_threshold = 0.8;
+    // MinHash-подпись из band_count * rows_per_band значений, кандидаты - документы с совпавшей полосой
+    size_t band_count = 16;
+    size_t rows_per_band = 4;
+};
+
+// id документов-дубликатов по возрастанию: из каждой группы остаётся документ с меньшим id.
+// точные дубликаты ищутся по хэшу отсортированного набора id слов с проверкой совпадения,
+// почти-дубликаты - по полосам MinHash (LSH) с проверкой меры Жаккара по самим наборам:
+// документ попадает в группу, только если похож на оставленный документ группы
+std::vector<int> FindDuplicates(const SearchServer& search_server, const DuplicateSearchOptions& options = {});
+std::vector<int> FindDuplicates(const std::execution::parallel_policy& policy, const SearchServer& search_server,
+                                const DuplicateSearchOptions& options = {});
+
 void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
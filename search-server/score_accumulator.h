@@ -0,0 +1,150 @@
+#pragma once
+#include "posting_list.h"
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <vector>
+
+// битовая отметка слотов из диапазона [first_slot, last_slot)
+class SlotBitmap {
+public:
+    SlotBitmap(DocumentSlot first_slot, DocumentSlot last_slot) {
+        Reset(first_slot, last_slot);
+    }
+
+    // все биты сброшены, память прежнего диапазона переиспользуется
+    void Reset(DocumentSlot first_slot, DocumentSlot last_slot) {
+        first_slot_ = first_slot;
+        bits_.assign((last_slot - first_slot + 63) / 64, 0);
+    }
+
+    void Set(DocumentSlot slot) {
+        const DocumentSlot offset = slot - first_slot_;
+        bits_[offset / 64] |= uint64_t{1} << (offset % 64);
+    }
+
+    bool Test(DocumentSlot slot) const {
+        const DocumentSlot offset = slot - first_slot_;
+        return (bits_[offset / 64] >> (offset % 64)) & 1;
+    }
+
+    // слово word покрывает слоты [first_slot + 64 * word, first_slot + 64 * (word + 1))
+    uint64_t GetWord(size_t word) const {
+        return bits_[word];
+    }
+
+    template <typename Function>
+    void ForEachSet(Function function) const {
+        for (size_t word = 0; word < bits_.size(); ++word) {
+            for (uint64_t bits = bits_[word]; bits != 0; bits &= bits - 1) {
+                function(static_cast<DocumentSlot>(first_slot_ + word * 64 + CountTrailingZeros(bits)));
+            }
+        }
+    }
+
+private:
+    DocumentSlot first_slot_;
+    std::vector<uint64_t> bits_;
+};
+
+// релевантности всех слотов диапазона в одном массиве, когда кандидатов много
+class DenseScoreAccumulator {
+public:
+    DenseScoreAccumulator(DocumentSlot first_slot, DocumentSlot last_slot)
+        : touched_(first_slot, last_slot) {
+        Reset(first_slot, last_slot);
+    }
+
+    void Reset(DocumentSlot first_slot, DocumentSlot last_slot) {
+        first_slot_ = first_slot;
+        scores_.assign(last_slot - first_slot, 0.0);
+        touched_.Reset(first_slot, last_slot);
+    }
+
+    void Add(DocumentSlot slot, double value) {
+        scores_[slot - first_slot_] += value;
+        touched_.Set(slot);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        touched_.ForEachSet([this, &function](DocumentSlot slot) {
+            function(slot, scores_[slot - first_slot_]);
+        });
+    }
+
+private:
+    DocumentSlot first_slot_;
+    std::vector<double> scores_;
+    SlotBitmap touched_;
+};
+
+// маленькая хэш-таблица с открытой адресацией, когда кандидатов мало
+class HashScoreAccumulator {
+public:
+    explicit HashScoreAccumulator(size_t expected_count) {
+        Reset(expected_count);
+    }
+
+    void Reset(size_t expected_count) {
+        size_t capacity = 16;
+        while (capacity < expected_count * 2) {
+            capacity *= 2;
+        }
+        slots_.assign(capacity, EMPTY);
+        scores_.assign(capacity, 0.0);
+        size_ = 0;
+    }
+
+    void Add(DocumentSlot slot, double value) {
+        size_t pos = Probe(slot);
+        if (slots_[pos] == EMPTY) {
+            if ((size_ + 1) * 2 > slots_.size()) {
+                Grow();
+                pos = Probe(slot);
+            }
+            slots_[pos] = slot;
+            ++size_;
+        }
+        scores_[pos] += value;
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (size_t pos = 0; pos < slots_.size(); ++pos) {
+            if (slots_[pos] != EMPTY) {
+                function(slots_[pos], scores_[pos]);
+            }
+        }
+    }
+
+private:
+    static constexpr DocumentSlot EMPTY = UINT32_MAX;
+
+    std::vector<DocumentSlot> slots_;
+    std::vector<double> scores_;
+    size_t size_ = 0;
+
+    size_t Probe(DocumentSlot slot) const {
+        const size_t mask = slots_.size() - 1;
+        size_t pos = (slot * uint64_t{0x9E3779B97F4A7C15}) >> 32 & mask;
+        while (slots_[pos] != EMPTY && slots_[pos] != slot) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    void Grow() {
+        std::vector<DocumentSlot> old_slots(slots_.size() * 2, EMPTY);
+        std::vector<double> old_scores(scores_.size() * 2, 0.0);
+        old_slots.swap(slots_);
+        old_scores.swap(scores_);
+        for (size_t pos = 0; pos < old_slots.size(); ++pos) {
+            if (old_slots[pos] != EMPTY) {
+                const size_t new_pos = Probe(old_slots[pos]);
+                slots_[new_pos] = old_slots[pos];
+                scores_[new_pos] = old_scores[pos];
+            }
+        }
+    }
+};
@@ -1,6 +1,9 @@
 #include "search_server.h"
 #include "process_queries.h"
-#include "concurrent_map.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
 
 SearchServer::SearchServer(const std::string_view stop_words_text)
         : SearchServer::SearchServer(SplitIntoWords(stop_words_text)){
@@ -10,39 +13,498 @@ SearchServer::SearchServer(const std::string& stop_word_text)
         : SearchServer::SearchServer(SplitIntoWords(stop_word_text)){
     }
 
+SearchServer::SearchServer(const IndexSnapshotPath& snapshot)
+        : SearchServer::SearchServer(std::make_shared<const MappedFile>(snapshot.path)) {
+    }
+
+SearchServer::SearchServer(std::shared_ptr<const MappedFile> index_file)
+        : stop_words_(LoadStopWords(*index_file))
+        , stop_word_filter_(stop_words_)
+        , index_file_(std::move(index_file)) {
+    // словарь и метаданные документов строятся за O(слов + документов), списки вхождений и прямой индекс
+    // смотрят в отображённый файл и проверяются при первом обращении
+    const SnapshotReader reader(*index_file_);
+    const SnapshotHeader& header = reader.GetHeader();
+    max_result_document_count_ = header.max_result_document_count;
+    // элементов в файле не больше, чем байт, поэтому count + 1 и count * 2 ниже не переполняются
+    const uint64_t file_size = index_file_->size();
+    if (header.term_count > file_size || header.posting_count > file_size || header.document_count > file_size
+        || header.forward_count > file_size || header.term_count >= TermDictionary::NO_TERM
+        || header.document_count >= REMOVED_SLOT) {
+        throw std::runtime_error("Index snapshot is corrupted"s);
+    }
+
+    for (std::string_view word : reader.GetStrings(header.term_count, header.term_offsets, header.term_bytes)) {
+        if (dictionary_.InternView(word) != word_to_document_freqs_.size()) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+        word_to_document_freqs_.emplace_back();
+    }
+    const auto* posting_offsets = reader.GetArray<uint64_t>(header.posting_offsets, header.term_count + 1);
+    const auto* posting_slots = reader.GetArray<DocumentSlot>(header.posting_slots, header.posting_count);
+    const auto* posting_term_freqs = reader.GetArray<double>(header.posting_term_freqs, header.posting_count);
+    const auto* posting_max_term_freqs = reader.GetArray<double>(header.posting_max_term_freqs, header.term_count);
+    for (TermId term_id = 0; term_id < header.term_count; ++term_id) {
+        if (posting_offsets[term_id] > posting_offsets[term_id + 1] || posting_offsets[term_id + 1] > header.posting_count) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+        word_to_document_freqs_[term_id] = PostingList::View(posting_slots + posting_offsets[term_id],
+            posting_term_freqs + posting_offsets[term_id], posting_offsets[term_id + 1] - posting_offsets[term_id],
+            posting_max_term_freqs[term_id]);
+    }
+
+    // отпечатки сохраняются, только если политика дубликатов была включена
+    if (header.duplicate_policy > static_cast<uint64_t>(DuplicatePolicy::FLAG)) {
+        throw std::runtime_error("Index snapshot is corrupted"s);
+    }
+    duplicate_policy_ = static_cast<DuplicatePolicy>(header.duplicate_policy);
+    const uint64_t* document_fingerprints = duplicate_policy_ == DuplicatePolicy::ALLOW ? nullptr
+        : reader.GetArray<uint64_t>(header.document_fingerprints, header.document_count * 2);
+
+    const auto* document_ids = reader.GetArray<int32_t>(header.document_ids, header.document_count);
+    const auto* document_ratings = reader.GetArray<int32_t>(header.document_ratings, header.document_count);
+    const auto* document_statuses = reader.GetArray<uint8_t>(header.document_statuses, header.document_count);
+    const auto* forward_offsets = reader.GetArray<uint64_t>(header.forward_offsets, header.document_count + 1);
+    const auto* forward_terms = reader.GetArray<TermId>(header.forward_terms, header.forward_count);
+    const auto* forward_term_freqs = reader.GetArray<double>(header.forward_term_freqs, header.forward_count);
+    documents_.reserve(header.document_count);
+    for (DocumentSlot slot = 0; slot < header.document_count; ++slot) {
+        if (forward_offsets[slot] > forward_offsets[slot + 1] || forward_offsets[slot + 1] > header.forward_count
+            || document_statuses[slot] > static_cast<uint8_t>(DocumentStatus::REMOVED)
+            || document_slots_.count(document_ids[slot]) > 0) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+        const size_t term_count = forward_offsets[slot + 1] - forward_offsets[slot];
+        DocumentData document_data{{},
+            MappableArray<TermId>::View(forward_terms + forward_offsets[slot], term_count),
+            MappableArray<double>::View(forward_term_freqs + forward_offsets[slot], term_count), {}};
+        if (document_fingerprints != nullptr) {
+            document_data.fingerprint = {document_fingerprints[slot * 2], document_fingerprints[slot * 2 + 1]};
+        }
+        AppendDocument(document_ids[slot], document_ratings[slot], static_cast<DocumentStatus>(document_statuses[slot]),
+                       std::move(document_data));
+    }
+
+    snapshot_checks_ = std::make_shared<SnapshotChecks>();
+    snapshot_checks_->term_count = header.term_count;
+    snapshot_checks_->document_count = header.document_count;
+    snapshot_checks_->posting_offsets = posting_offsets;
+    snapshot_checks_->posting_slots = posting_slots;
+    snapshot_checks_->forward_offsets = forward_offsets;
+    snapshot_checks_->forward_terms = forward_terms;
+    snapshot_checks_->checked_terms = std::make_unique<std::atomic<bool>[]>(header.term_count);
+    snapshot_checks_->checked_documents = std::make_unique<std::atomic<bool>[]>(header.document_count);
+}
+
+void SearchServer::CheckSnapshotTerm(TermId term_id) const {
+    if (snapshot_checks_ == nullptr || term_id >= snapshot_checks_->term_count
+        || snapshot_checks_->checked_terms[term_id].load(std::memory_order_acquire)) {
+        return;
+    }
+    // слоты служат индексами столбцов и накопителей, поэтому проверяются значения, а не только смещения
+    const SnapshotChecks& checks = *snapshot_checks_;
+    const uint64_t first = checks.posting_offsets[term_id];
+    const uint64_t last = checks.posting_offsets[term_id + 1];
+    for (uint64_t i = first; i < last; ++i) {
+        if (checks.posting_slots[i] >= checks.document_count || (i > first && checks.posting_slots[i] <= checks.posting_slots[i - 1])) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+    }
+    checks.checked_terms[term_id].store(true, std::memory_order_release);
+}
+
+void SearchServer::CheckSnapshotDocument(DocumentSlot slot) const {
+    if (snapshot_checks_ == nullptr || slot >= snapshot_checks_->document_count
+        || snapshot_checks_->checked_documents[slot].load(std::memory_order_acquire)) {
+        return;
+    }
+    const SnapshotChecks& checks = *snapshot_checks_;
+    for (uint64_t i = checks.forward_offsets[slot]; i < checks.forward_offsets[slot + 1]; ++i) {
+        if (checks.forward_terms[i] >= checks.term_count) {
+            throw std::runtime_error("Index snapshot is corrupted"s);
+        }
+    }
+    checks.checked_documents[slot].store(true, std::memory_order_release);
+}
+
+void SearchServer::CheckSnapshot() const {
+    if (snapshot_checks_ == nullptr) {
+        return;
+    }
+    for (TermId term_id = 0; term_id < snapshot_checks_->term_count; ++term_id) {
+        CheckSnapshotTerm(term_id);
+    }
+    for (DocumentSlot slot = 0; slot < snapshot_checks_->document_count; ++slot) {
+        CheckSnapshotDocument(slot);
+    }
+}
+
+std::set<std::string, std::less<>> SearchServer::LoadStopWords(const MappedFile& index_file) {
+    const SnapshotReader reader(index_file);
+    const SnapshotHeader& header = reader.GetHeader();
+    return MakeUniqueNonEmptyStrings(reader.GetStrings(header.stop_word_count, header.stop_word_offsets, header.stop_word_bytes));
+}
+
+void SearchServer::Save(const std::string& path) const {
+    SnapshotWriter writer(path);
+    SnapshotHeader header{};
+    std::memcpy(header.magic, SnapshotHeader::MAGIC, sizeof(header.magic));
+    header.version = SnapshotHeader::VERSION;
+    header.byte_order_mark = SnapshotHeader::BYTE_ORDER_MARK;
+    header.max_result_document_count = max_result_document_count_;
+    CheckSnapshot();
+
+    const std::vector<std::string_view> stop_words(stop_words_.begin(), stop_words_.end());
+    header.stop_word_count = stop_words.size();
+    std::tie(header.stop_word_offsets, header.stop_word_bytes) = writer.WriteStrings(stop_words);
+
+    std::vector<std::string_view> terms(dictionary_.size());
+    for (TermId term_id = 0; term_id < terms.size(); ++term_id) {
+        terms[term_id] = dictionary_.GetWord(term_id);
+    }
+    header.term_count = terms.size();
+    std::tie(header.term_offsets, header.term_bytes) = writer.WriteStrings(terms);
+
+    // слоты удалённых документов в снимок не попадают, живые нумеруются заново в том же порядке
+    const std::vector<DocumentSlot> new_slots = NumberLiveSlots();
+
+    std::vector<uint64_t> posting_offsets{0};
+    std::vector<DocumentSlot> posting_slots;
+    std::vector<double> posting_term_freqs;
+    std::vector<double> posting_max_term_freqs;
+    std::vector<std::pair<DocumentSlot, double>> postings;
+    for (const PostingList& posting_list : word_to_document_freqs_) {
+        postings.clear();
+        posting_list.ForEach([&](DocumentSlot slot, double term_freq) {
+            if (document_columns_.statuses[slot] != REMOVED_STATUS) {
+                postings.emplace_back(new_slots[slot], term_freq);
+            }
+        });
+        std::sort(postings.begin(), postings.end());
+        double max_term_freq = 0.0;
+        for (const auto& [slot, term_freq] : postings) {
+            posting_slots.push_back(slot);
+            posting_term_freqs.push_back(term_freq);
+            max_term_freq = std::max(max_term_freq, term_freq);
+        }
+        posting_max_term_freqs.push_back(max_term_freq);
+        posting_offsets.push_back(posting_slots.size());
+    }
+    header.posting_count = posting_slots.size();
+    header.posting_offsets = writer.WriteArray(posting_offsets);
+    header.posting_slots = writer.WriteArray(posting_slots);
+    header.posting_term_freqs = writer.WriteArray(posting_term_freqs);
+    header.posting_max_term_freqs = writer.WriteArray(posting_max_term_freqs);
+
+    std::vector<int32_t> document_ids;
+    std::vector<int32_t> document_ratings;
+    std::vector<uint8_t> document_statuses;
+    std::vector<uint64_t> forward_offsets{0};
+    std::vector<TermId> forward_terms;
+    std::vector<double> forward_term_freqs;
+    std::vector<uint64_t> document_fingerprints;
+    for (DocumentSlot slot = 0; slot < documents_.size(); ++slot) {
+        if (new_slots[slot] == REMOVED_SLOT) {
+            continue;
+        }
+        const DocumentData& document_data = documents_[slot];
+        if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+            document_fingerprints.push_back(document_data.fingerprint.low);
+            document_fingerprints.push_back(document_data.fingerprint.high);
+        }
+        document_ids.push_back(document_columns_.ids[slot]);
+        document_ratings.push_back(document_columns_.ratings[slot]);
+        document_statuses.push_back(document_columns_.statuses[slot]);
+        forward_terms.insert(forward_terms.end(), document_data.terms.begin(), document_data.terms.end());
+        forward_term_freqs.insert(forward_term_freqs.end(), document_data.term_freqs.begin(), document_data.term_freqs.end());
+        forward_offsets.push_back(forward_terms.size());
+    }
+    header.document_count = document_ids.size();
+    header.document_ids = writer.WriteArray(document_ids);
+    header.document_ratings = writer.WriteArray(document_ratings);
+    header.document_statuses = writer.WriteArray(document_statuses);
+    header.forward_count = forward_terms.size();
+    header.forward_offsets = writer.WriteArray(forward_offsets);
+    header.forward_terms = writer.WriteArray(forward_terms);
+    header.forward_term_freqs = writer.WriteArray(forward_term_freqs);
+    header.duplicate_policy = static_cast<uint64_t>(duplicate_policy_);
+    header.document_fingerprints = writer.WriteArray(document_fingerprints);
+
+    writer.Finish(header);
+}
+
 void SearchServer::AddDocument(int document_id, std::string_view document,
                                DocumentStatus status,
                                const std::vector<int>& ratings) {
-        if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+        if ((document_id < 0) || (document_slots_.count(document_id) > 0)) {
             throw std::invalid_argument("Invalid document_id"s);
         }
-        DocumentData doc_{0,status, static_cast<std::string>(document) };
-        std::vector<std::string_view> words = SplitIntoWordsNoStop(doc_.document_content);
+        std::vector<std::string_view>& words = document_words_;
+        SplitIntoWordsNoStop(document, words);
+        const auto slot = static_cast<DocumentSlot>(documents_.size());
+        DocumentFingerprint fingerprint;
+        if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+            std::vector<std::string_view> unique_words = words;
+            std::sort(unique_words.begin(), unique_words.end());
+            unique_words.erase(std::unique(unique_words.begin(), unique_words.end()), unique_words.end());
+            for (std::string_view word : unique_words) {
+                fingerprint.AddWord(word);
+            }
+            CheckDuplicate(document_id, fingerprint);
+        }
 
         const double inv_word_count = 1.0 / words.size();
+        std::map<TermId, double> term_freqs;
         for (std::string_view word : words) {
-            word_to_document_freqs_[word][document_id] += inv_word_count;
-            id_with_words_freq[document_id][word] += inv_word_count;
+            const TermId term_id = dictionary_.Intern(word);
+            if (term_id == word_to_document_freqs_.size()) {
+                word_to_document_freqs_.emplace_back();
+            }
+            term_freqs[term_id] += inv_word_count;
+        }
+        DocumentData document_data{document_texts_.Store(document), {}, {}, {}};
+        std::vector<TermId> document_terms;
+        std::vector<double> document_term_freqs;
+        for (const auto& [term_id, term_freq] : term_freqs) {
+            word_to_document_freqs_[term_id].Add(slot, term_freq);
+            document_terms.push_back(term_id);
+            document_term_freqs.push_back(term_freq);
+        }
+        document_data.terms.Assign(std::move(document_terms));
+        document_data.term_freqs.Assign(std::move(document_term_freqs));
+        document_data.fingerprint = fingerprint;
+        AppendDocument(document_id, ComputeAverageRating(ratings), status, std::move(document_data));
+        ++index_epoch_;
+}
+
+void SearchServer::AddDocumentsFrom(const SearchServer& other, const std::unordered_set<int>& skipped_ids) {
+    // слоты other перебираются по возрастанию, чтобы списки вхождений пополнялись с конца
+    std::vector<DocumentSlot> slots;
+    for (const auto& [document_id, slot] : other.document_slots_) {
+        if (skipped_ids.count(document_id) > 0) {
+            continue;
+        }
+        if (document_slots_.count(document_id) > 0) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+        slots.push_back(slot);
+    }
+    std::sort(slots.begin(), slots.end());
+
+    std::vector<TermId> term_ids(other.dictionary_.size(), TermDictionary::NO_TERM);
+    documents_.reserve(documents_.size() + slots.size());
+    for (const DocumentSlot other_slot : slots) {
+        other.CheckSnapshotDocument(other_slot);
+        const DocumentData& other_data = other.documents_[other_slot];
+        const auto slot = static_cast<DocumentSlot>(documents_.size());
+        std::vector<std::pair<TermId, double>> term_freqs;
+        for (size_t i = 0; i < other_data.terms.size(); ++i) {
+            TermId& term_id = term_ids[other_data.terms[i]];
+            if (term_id == TermDictionary::NO_TERM) {
+                term_id = dictionary_.Intern(other.dictionary_.GetWord(other_data.terms[i]));
+                if (term_id == word_to_document_freqs_.size()) {
+                    word_to_document_freqs_.emplace_back();
+                }
+            }
+            term_freqs.emplace_back(term_id, other_data.term_freqs[i]);
+        }
+        std::sort(term_freqs.begin(), term_freqs.end());
+        DocumentData document_data{document_texts_.Store(other_data.text), {}, {}, {}};
+        std::vector<TermId> document_terms;
+        std::vector<double> document_term_freqs;
+        for (const auto& [term_id, term_freq] : term_freqs) {
+            word_to_document_freqs_[term_id].Add(slot, term_freq);
+            document_terms.push_back(term_id);
+            document_term_freqs.push_back(term_freq);
+        }
+        document_data.terms.Assign(std::move(document_terms));
+        document_data.term_freqs.Assign(std::move(document_term_freqs));
+        if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+            document_data.fingerprint = ComputeFingerprint(document_data.terms);
+        }
+        AppendDocument(other.document_columns_.ids[other_slot], other.document_columns_.ratings[other_slot],
+                       static_cast<DocumentStatus>(other.document_columns_.statuses[other_slot]), std::move(document_data));
+    }
+    ++index_epoch_;
+}
+
+void SearchServer::ValidateNewDocuments(const std::vector<const NewDocument*>& documents) const {
+    std::unordered_set<int> batch_ids;
+    for (const NewDocument* document : documents) {
+        if (document->id < 0 || document_slots_.count(document->id) > 0 || !batch_ids.insert(document->id).second) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+    }
+}
+
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(const std::vector<const NewDocument*>& documents,
+                                                           size_t first, size_t last, DocumentSlot first_slot) const {
+    PartialIndex result;
+    try {
+        std::unordered_map<std::string_view, TermId> local_term_ids;
+        result.document_terms.resize(last - first);
+        std::vector<std::string_view> words;
+        for (size_t i = first; i < last; ++i) {
+            SplitIntoWordsNoStop(documents[i]->text, words);
+            const double inv_word_count = 1.0 / words.size();
+            std::map<TermId, double> term_freqs;
+            for (std::string_view word : words) {
+                const auto [it, inserted] = local_term_ids.emplace(word, static_cast<TermId>(result.words.size()));
+                if (inserted) {
+                    result.words.push_back(word);
+                    result.postings.emplace_back();
+                }
+                term_freqs[it->second] += inv_word_count;
+            }
+            const auto slot = static_cast<DocumentSlot>(first_slot + (i - first));
+            for (const auto& [local_term_id, term_freq] : term_freqs) {
+                result.postings[local_term_id].emplace_back(slot, term_freq);
+                result.document_terms[i - first].emplace_back(local_term_id, term_freq);
+            }
+            if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+                DocumentFingerprint& fingerprint = result.fingerprints.emplace_back();
+                for (const auto& [local_term_id, term_freq] : term_freqs) {
+                    fingerprint.AddWord(result.words[local_term_id]);
+                }
+            }
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, static_cast<std::string>(document) });
-        docs_index.insert(document_id);
+    }
+    catch (...) {
+        result.error = std::current_exception();
+    }
+    return result;
+}
+
+std::vector<std::tuple<TermId, size_t, TermId>> SearchServer::InternPartialIndexes(std::vector<PartialIndex>& partial_indexes) {
+    std::vector<std::tuple<TermId, size_t, TermId>> term_sources;
+    for (size_t chunk = 0; chunk < partial_indexes.size(); ++chunk) {
+        PartialIndex& partial_index = partial_indexes[chunk];
+        partial_index.global_term_ids.resize(partial_index.words.size());
+        for (TermId local_term_id = 0; local_term_id < partial_index.words.size(); ++local_term_id) {
+            const TermId term_id = dictionary_.Intern(partial_index.words[local_term_id]);
+            partial_index.global_term_ids[local_term_id] = term_id;
+            term_sources.emplace_back(term_id, chunk, local_term_id);
+        }
+    }
+    std::sort(term_sources.begin(), term_sources.end());
+    return term_sources;
+}
+
+SearchServer::DocumentData SearchServer::MakeDocumentData(const PartialIndex& partial_index, size_t index) const {
+    // текст копируется в арену позже, последовательно
+    DocumentData document_data;
+    if (!partial_index.fingerprints.empty()) {
+        document_data.fingerprint = partial_index.fingerprints[index];
+    }
+    std::vector<std::pair<TermId, double>> term_freqs;
+    for (const auto& [local_term_id, term_freq] : partial_index.document_terms[index]) {
+        term_freqs.emplace_back(partial_index.global_term_ids[local_term_id], term_freq);
+    }
+    std::sort(term_freqs.begin(), term_freqs.end());
+    std::vector<TermId> terms;
+    std::vector<double> freqs;
+    for (const auto& [term_id, term_freq] : term_freqs) {
+        terms.push_back(term_id);
+        freqs.push_back(term_freq);
+    }
+    document_data.terms.Assign(std::move(terms));
+    document_data.term_freqs.Assign(std::move(freqs));
+    return document_data;
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-        return SearchServer::FindTopDocuments(
-            raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+        return SearchServer::FindTopDocuments(std::execution::seq, raw_query, status);
     }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
         return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
     }
 
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query,
+                                                            DocumentStatus status) const {
+    return SearchServer::FindTopDocuments(context, raw_query, StatusFilter{status});
+}
+
+size_t SearchServer::EstimateQueryCost(std::string_view raw_query) const {
+    size_t cost = 0;
+    for (const TermId term_id : ParseQuery(raw_query).plus_terms) {
+        cost += word_to_document_freqs_[term_id].size();
+    }
+    return cost;
+}
+
 size_t SearchServer::GetDocumentCount() const {
-        return documents_.size();
+        return document_slots_.size();
     }
 
+size_t SearchServer::GetDocumentFreq(std::string_view word) const {
+    const TermId term_id = dictionary_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : word_to_document_freqs_[term_id].size();
+}
+
+void SearchServer::SetMaxResultDocumentCount(size_t max_count) {
+    max_result_document_count_ = max_count;
+}
+
+size_t SearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void SearchServer::CompressPostings() {
+    CompressPostings(std::execution::seq);
+}
+
+void SearchServer::PurgeRemovedDocuments() {
+    PurgeRemovedDocuments(std::execution::seq);
+}
+
+size_t SearchServer::GetPostingsMemoryUsage() const {
+    size_t memory_usage = 0;
+    for (const PostingList& postings : word_to_document_freqs_) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+    return memory_usage;
+}
+
+void SearchServer::EnableQueryCache(size_t capacity) {
+    query_cache_ = std::make_unique<QueryCache>(capacity);
+}
+
+void SearchServer::DisableQueryCache() {
+    query_cache_.reset();
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const {
+    return query_cache_ ? query_cache_->GetStats() : QueryCacheStats{};
+}
+
+void SearchServer::SetDuplicatePolicy(DuplicatePolicy policy) {
+    if (policy == DuplicatePolicy::ALLOW) {
+        fingerprint_documents_.clear();
+    }
+    else if (duplicate_policy_ == DuplicatePolicy::ALLOW) {
+        // при ALLOW отпечатки не считались, индекс строится по прямому индексу живых документов
+        for (const auto& [document_id, slot] : document_slots_) {
+            CheckSnapshotDocument(slot);
+            documents_[slot].fingerprint = ComputeFingerprint(documents_[slot].terms);
+            RegisterFingerprint(slot);
+        }
+    }
+    duplicate_policy_ = policy;
+}
+
+DuplicatePolicy SearchServer::GetDuplicatePolicy() const {
+    return duplicate_policy_;
+}
+
+bool SearchServer::IsDuplicate(int document_id) const {
+    if (duplicate_policy_ == DuplicatePolicy::ALLOW || document_slots_.count(document_id) == 0) {
+        return false;
+    }
+    const auto it = fingerprint_documents_.find(documents_[GetSlot(document_id)].fingerprint);
+    return it != fingerprint_documents_.end() && it->second.front() != document_id;
+}
+
 std::set<int>::const_iterator SearchServer::begin() const {
 	return docs_index.begin();
 }
@@ -60,18 +522,19 @@ std::set<int>::iterator SearchServer::end() {
 }
 
 void SearchServer::RemoveDocument(int document_id){
-    if(id_with_words_freq.count(document_id) == 0){
+    const auto it = document_slots_.find(document_id);
+    if (it == document_slots_.end()) {
         return;
     }
-    for (const auto& [word, freq] : id_with_words_freq.at(document_id)){
-    auto it = word_to_document_freqs_.at(word).find(document_id);
-        if (it != word_to_document_freqs_.at(word).end()){
-            word_to_document_freqs_.at(word).erase(it);
-        }
+    const DocumentSlot slot = it->second;
+    CheckSnapshotDocument(slot);
+    for (const TermId term_id : documents_[slot].terms){
+        word_to_document_freqs_[term_id].MarkStale();
     }
-    docs_index.erase(find(docs_index.begin(),docs_index.end(),document_id));
-    id_with_words_freq.erase(document_id);
-    documents_.erase(document_id);
+    docs_index.erase(document_id);
+    ReleaseSlot(slot);
+    document_slots_.erase(it);
+    ++index_epoch_;
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id){
@@ -79,43 +542,42 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int d
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id){
-    if(id_with_words_freq.count(document_id) == 0){
+    const auto it = document_slots_.find(document_id);
+    if (it == document_slots_.end()) {
         return;
     }
-    std::vector<std::string_view> strings_(id_with_words_freq.at(document_id).size());
-    transform(policy, id_with_words_freq.at(document_id).begin(), id_with_words_freq.at(document_id).end(), strings_.begin(), [](auto document_){return document_.first;});
-    auto p = [this, document_id](std::string_view str_){word_to_document_freqs_.at(str_).erase(document_id);};
-    for_each(policy, strings_.begin(), strings_.end(), p);
-    docs_index.erase(find(policy, docs_index.begin(),docs_index.end(),document_id));
-    id_with_words_freq.erase(document_id);
-    documents_.erase(document_id);
+    const DocumentSlot slot = it->second;
+    CheckSnapshotDocument(slot);
+    const auto& terms_ = documents_[slot].terms;
+    auto p = [this](TermId term_id){word_to_document_freqs_[term_id].MarkStale();};
+    std::for_each(policy, terms_.begin(), terms_.end(), p);
+    docs_index.erase(document_id);
+    ReleaseSlot(slot);
+    document_slots_.erase(it);
+    ++index_epoch_;
 }
 
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query,
                                                         int document_id) const {
-        if (0 == documents_.count(document_id)) {
+        if (0 == document_slots_.count(document_id)) {
         throw std::out_of_range("There is no document with this document_id"s);
         }
         const auto query = ParseQuery(raw_query);
-        for (const std::string_view& word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                return { {},documents_.at(document_id).status };
+        const DocumentSlot slot = GetSlot(document_id);
+        for (const TermId term_id : query.minus_terms) {
+            if (HasTerm(term_id, slot)) {
+                return { std::vector<std::string_view>{}, static_cast<DocumentStatus>(document_columns_.statuses[slot]) };
             }
         }
         std::vector<std::string_view> matched_words;
-        for (const std::string_view& word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            if (word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.push_back(word);
+        for (const TermId term_id : query.plus_terms) {
+            if (HasTerm(term_id, slot)) {
+                matched_words.push_back(dictionary_.GetWord(term_id));
             }
         }
-        return {matched_words, documents_.at(document_id).status};
+        sort(matched_words.begin(), matched_words.end());
+        return {matched_words, static_cast<DocumentStatus>(document_columns_.statuses[slot])};
     }
 
 SearchServer::DocTuple SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const {
@@ -123,40 +585,42 @@ SearchServer::DocTuple SearchServer::MatchDocument(const std::execution::sequenc
 }
    
 SearchServer::DocTuple SearchServer::MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const {
-    if (0 == documents_.count(document_id)) {
+    if (0 == document_slots_.count(document_id)) {
         throw std::out_of_range("There is no document with this document_id"s);
     }
-    const auto query = ParseQuery(raw_query,1);
+    const auto query = ParseQuery(raw_query);
+    const DocumentSlot slot = GetSlot(document_id);
     if (std::any_of(std::execution::par
-        , query.minus_words.begin()
-        , query.minus_words.end()
-        , [this, document_id](const auto& word) {
-            return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id);
+        , query.minus_terms.begin()
+        , query.minus_terms.end()
+        , [this, slot](TermId term_id) {
+            return HasTerm(term_id, slot);
         }
         )
         ) {
-        return { {},documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, static_cast<DocumentStatus>(document_columns_.statuses[slot]) };
     }
-    std::vector<std::string_view> matched_words (query.plus_words.size());
+    std::vector<TermId> matched_terms (query.plus_terms.size());
     auto it = std::copy_if (policy,
-                    query.plus_words.begin(),
-                    query.plus_words.end(),
-                    matched_words.begin(),
-                    [this, document_id](const auto& word){
-                        return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id);}
+                    query.plus_terms.begin(),
+                    query.plus_terms.end(),
+                    matched_terms.begin(),
+                    [this, slot](TermId term_id){
+                        return HasTerm(term_id, slot);}
     );
-    matched_words.erase(it, matched_words.end());
+    matched_terms.erase(it, matched_terms.end());
+    std::vector<std::string_view> matched_words (matched_terms.size());
+    transform(policy, matched_terms.begin(), matched_terms.end(), matched_words.begin(),
+        [this](TermId term_id) { return dictionary_.GetWord(term_id); });
     sort(policy, matched_words.begin(),
         matched_words.end()
         );
-    
-    matched_words.erase(unique(policy, matched_words.begin(), matched_words.end()), matched_words.end());
-        return {matched_words, documents_.at(document_id).status};
+        return {matched_words, static_cast<DocumentStatus>(document_columns_.statuses[slot])};
     }
 
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-        return stop_words_.count(word) > 0;
+        return stop_word_filter_.Contains(word);
     }
 
 bool SearchServer::IsValidWord(std::string_view word) {
@@ -165,25 +629,185 @@ bool SearchServer::IsValidWord(std::string_view word) {
         });
     }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-        std::vector<std::string_view> words;
-        for (std::string_view word : SplitIntoWords(text)) {
-            if (!IsValidWord(word)) {
-                throw std::invalid_argument("Word "s + static_cast<std::string>(word) + " is invalid"s);
-            }
-            if (!IsStopWord(word)) {
-                words.push_back(word);
-            }
+void SearchServer::SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const {
+        const size_t invalid_word = SplitIntoWords(text, words);
+        if (invalid_word != words.size()) {
+            throw std::invalid_argument("Word "s + static_cast<std::string>(words[invalid_word]) + " is invalid"s);
         }
-        return words;
+        words.erase(std::remove_if(words.begin(), words.end(), [this](std::string_view word) {
+            return IsStopWord(word);
+        }), words.end());
     }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const{
-    static std::map<std::string_view, double> word_freq;
-    if (id_with_words_freq.count(document_id) == 0){
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const{
+    std::map<std::string_view, double> word_freq;
+    if (document_slots_.count(document_id) == 0){
         return word_freq;
     }
-    return id_with_words_freq.at(document_id);
+    const DocumentSlot slot = GetSlot(document_id);
+    CheckSnapshotDocument(slot);
+    const DocumentData& document_data = documents_[slot];
+    for (size_t i = 0; i < document_data.terms.size(); ++i) {
+        word_freq.emplace(dictionary_.GetWord(document_data.terms[i]), document_data.term_freqs[i]);
+    }
+    return word_freq;
+}
+
+const MappableArray<TermId>& SearchServer::GetDocumentTerms(int document_id) const {
+    const DocumentSlot slot = GetSlot(document_id);
+    CheckSnapshotDocument(slot);
+    return documents_[slot].terms;
+}
+
+DocumentFingerprint SearchServer::ComputeFingerprint(const MappableArray<TermId>& terms) const {
+    DocumentFingerprint fingerprint;
+    for (const TermId term_id : terms) {
+        fingerprint.AddWord(dictionary_.GetWord(term_id));
+    }
+    return fingerprint;
+}
+
+void SearchServer::CheckDuplicate(int document_id, const DocumentFingerprint& fingerprint) const {
+    if (duplicate_policy_ != DuplicatePolicy::REJECT) {
+        return;
+    }
+    const auto it = fingerprint_documents_.find(fingerprint);
+    if (it != fingerprint_documents_.end()) {
+        throw std::invalid_argument("Document "s + std::to_string(document_id) + " duplicates document "s
+            + std::to_string(it->second.front()));
+    }
+}
+
+void SearchServer::RegisterFingerprint(DocumentSlot slot) {
+    const int document_id = document_columns_.ids[slot];
+    std::vector<int>& document_ids = fingerprint_documents_[documents_[slot].fingerprint];
+    document_ids.insert(std::lower_bound(document_ids.begin(), document_ids.end(), document_id), document_id);
+}
+
+void SearchServer::UnregisterFingerprint(DocumentSlot slot) {
+    const auto it = fingerprint_documents_.find(documents_[slot].fingerprint);
+    if (it == fingerprint_documents_.end()) {
+        return;
+    }
+    const int document_id = document_columns_.ids[slot];
+    std::vector<int>& document_ids = it->second;
+    const auto position = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    if (position != document_ids.end() && *position == document_id) {
+        document_ids.erase(position);
+    }
+    if (document_ids.empty()) {
+        fingerprint_documents_.erase(it);
+    }
+}
+
+void SearchServer::AppendDocument(int document_id, int rating, DocumentStatus status, DocumentData document_data) {
+    const auto slot = static_cast<DocumentSlot>(documents_.size());
+    documents_.push_back(std::move(document_data));
+    AppendDocumentColumns(document_id, rating, status);
+    document_slots_.emplace(document_id, slot);
+    docs_index.insert(document_id);
+    if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+        RegisterFingerprint(slot);
+    }
+}
+
+void SearchServer::AppendDocumentColumns(int document_id, int rating, DocumentStatus status) {
+    const size_t slot = document_columns_.ids.size();
+    document_columns_.ids.push_back(document_id);
+    document_columns_.ratings.push_back(rating);
+    document_columns_.statuses.push_back(static_cast<uint8_t>(status));
+    if (slot % SLOT_BLOCK_SIZE == 0) {
+        document_columns_.blocks.push_back({document_id, document_id, rating, rating, 0});
+    }
+    SlotBlockSummary& summary = document_columns_.blocks.back();
+    summary.min_id = std::min(summary.min_id, document_id);
+    summary.max_id = std::max(summary.max_id, document_id);
+    summary.min_rating = std::min(summary.min_rating, rating);
+    summary.max_rating = std::max(summary.max_rating, rating);
+    summary.status_mask |= uint32_t{1} << static_cast<int>(status);
+}
+
+std::vector<DocumentSlot> SearchServer::NumberLiveSlots() const {
+    std::vector<DocumentSlot> new_slots(documents_.size(), REMOVED_SLOT);
+    DocumentSlot new_slot = 0;
+    for (DocumentSlot slot = 0; slot < documents_.size(); ++slot) {
+        if (document_columns_.statuses[slot] != REMOVED_STATUS) {
+            new_slots[slot] = new_slot++;
+        }
+    }
+    return new_slots;
+}
+
+void SearchServer::CompactDocumentSlots(const std::vector<DocumentSlot>& new_slots) {
+    std::vector<DocumentData> documents = std::move(documents_);
+    const DocumentColumns columns = std::move(document_columns_);
+    documents_ = {};
+    document_columns_ = {};
+    documents_.reserve(document_slots_.size());
+    document_columns_.ids.reserve(document_slots_.size());
+    document_columns_.ratings.reserve(document_slots_.size());
+    document_columns_.statuses.reserve(document_slots_.size());
+    for (DocumentSlot slot = 0; slot < documents.size(); ++slot) {
+        if (new_slots[slot] == REMOVED_SLOT) {
+            continue;
+        }
+        documents_.push_back(std::move(documents[slot]));
+        AppendDocumentColumns(columns.ids[slot], columns.ratings[slot], static_cast<DocumentStatus>(columns.statuses[slot]));
+    }
+    for (auto& [document_id, slot] : document_slots_) {
+        slot = new_slots[slot];
+    }
+    stale_document_count_ = 0;
+    ++index_epoch_;
+    // слоты снимка проверены и больше не совпадают с номерами в файле
+    snapshot_checks_.reset();
+}
+
+void SearchServer::CompileFilter(const DocumentFilter& filter, CompiledFilter& compiled) const {
+    compiled.status_mask = filter.GetStatusMask();
+    compiled.min_rating = filter.GetMinRating();
+    compiled.max_rating = filter.GetMaxRating();
+    compiled.min_id = filter.GetMinId();
+    compiled.max_id = filter.GetMaxId();
+    compiled.has_id_range = compiled.min_id != INT_MIN || compiled.max_id != INT_MAX;
+    const auto slot_count = static_cast<DocumentSlot>(documents_.size());
+    // id, которых нет среди живых документов, пропускаются
+    auto fill_slots = [&](const std::vector<int>& document_ids, SlotBitmap& slots) {
+        slots.Reset(0, slot_count);
+        for (const int document_id : document_ids) {
+            const auto it = document_slots_.find(document_id);
+            if (it != document_slots_.end()) {
+                slots.Set(it->second);
+            }
+        }
+    };
+    compiled.has_allowed_slots = filter.HasAllowedIds();
+    if (compiled.has_allowed_slots) {
+        fill_slots(filter.GetAllowedIds(), compiled.allowed_slots);
+    }
+    compiled.has_denied_slots = !filter.GetDeniedIds().empty();
+    if (compiled.has_denied_slots) {
+        fill_slots(filter.GetDeniedIds(), compiled.denied_slots);
+    }
+    const size_t block_count = document_columns_.blocks.size();
+    compiled.selectable_blocks.Reset(0, static_cast<DocumentSlot>(block_count));
+    compiled.has_unselectable_blocks = false;
+    for (size_t block = 0; block < block_count; ++block) {
+        if (IsBlockSelectable(block, compiled)) {
+            compiled.selectable_blocks.Set(static_cast<DocumentSlot>(block));
+        }
+        else {
+            compiled.has_unselectable_blocks = true;
+        }
+    }
+}
+
+bool SearchServer::IsBlockSelectable(size_t block, const CompiledFilter& filter) const {
+    const SlotBlockSummary& summary = document_columns_.blocks[block];
+    return (summary.status_mask & filter.status_mask) != 0
+        && summary.max_rating >= filter.min_rating && summary.min_rating <= filter.max_rating
+        && summary.max_id >= filter.min_id && summary.min_id <= filter.max_id
+        && (!filter.has_allowed_slots || filter.allowed_slots.GetWord(block) != 0);
 }
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
@@ -197,7 +821,7 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
         return rating_sum / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text, bool has_control_chars) const {
     bool is_minus = false;
     if (text[0] == '-') {
         is_minus = true;
@@ -208,41 +832,127 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
             throw std::invalid_argument("Query word is empty"s);
     }
     
-    if (text[0] == '-' || !IsValidWord(text)) {
+    if (text[0] == '-' || has_control_chars) {
         throw std::invalid_argument("Query word "s + static_cast<std::string>(text) + " is invalid");
     }
 
     return {text, is_minus, IsStopWord(text)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool policy) const {
+SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
+    ThreadLocalScratch<QueryContext> context;
+    ParseQuery(text, *context);
+    return context->query_;
+}
+
+void SearchServer::ParseQuery(std::string_view text, QueryContext& context) const {
     if (text.empty()) {
         throw std::invalid_argument("Query word is empty"s);
     }
-    Query result;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                result.minus_words.push_back(query_word.data);
-            }
-            else {
-                result.plus_words.push_back(query_word.data);
-            }
+    Query& result = context.query_;
+    result.plus_terms.clear();
+    result.minus_terms.clear();
+    result.inverse_document_freqs.clear();
+    std::vector<std::string_view>& words = context.words_;
+    const size_t invalid_word = SplitIntoWords(text, words);
+    for (size_t i = 0; i < words.size(); ++i) {
+        const auto query_word = ParseQueryWord(words[i], i == invalid_word);
+        if (query_word.is_stop) {
+            continue;
         }
+        // слова, которых нет в словаре, не влияют ни на поиск, ни на матчинг
+        const TermId term_id = dictionary_.Find(query_word.data);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        if (query_word.is_minus) {
+            result.minus_terms.push_back(term_id);
+        }
+        else {
+            result.plus_terms.push_back(term_id);
+        }
+    }
+    sort(result.minus_terms.begin(), result.minus_terms.end());
+    sort(result.plus_terms.begin(), result.plus_terms.end());
+    result.minus_terms.erase(unique(result.minus_terms.begin(), result.minus_terms.end()), result.minus_terms.end());
+    result.plus_terms.erase(unique(result.plus_terms.begin(), result.plus_terms.end()), result.plus_terms.end());
+    for (const TermId term_id : result.plus_terms) {
+        CheckSnapshotTerm(term_id);
+    }
+    for (const TermId term_id : result.minus_terms) {
+        CheckSnapshotTerm(term_id);
+    }
+}
+
+DocumentSlot SearchServer::GetSlot(int document_id) const {
+    return document_slots_.at(document_id);
+}
+
+void SearchServer::ReleaseSlot(DocumentSlot slot) {
+    // слот освобождается только в PurgeRemovedDocuments, текст и прямой индекс - сразу
+    DocumentData& document_data = documents_[slot];
+    if (duplicate_policy_ != DuplicatePolicy::ALLOW) {
+        UnregisterFingerprint(slot);
+    }
+    document_columns_.statuses[slot] = REMOVED_STATUS;
+    ++stale_document_count_;
+    document_texts_.Release(document_data.text);
+    document_data.text = {};
+    document_data.terms.Assign({});
+    document_data.term_freqs.Assign({});
+    if (document_texts_.NeedsCompaction()) {
+        CompactDocumentTexts();
+    }
+}
+
+void SearchServer::CompactDocumentTexts() {
+    TextArena compacted;
+    for (DocumentData& document_data : documents_) {
+        document_data.text = compacted.Store(document_data.text);
     }
-    if (!policy) {
-        sort(result.minus_words.begin(), result.minus_words.end());
-        sort(result.plus_words.begin(), result.plus_words.end());
-        result.minus_words.erase(unique(result.minus_words.begin(), result.minus_words.end()), result.minus_words.end());
-        result.plus_words.erase(unique(result.plus_words.begin(), result.plus_words.end()), result.plus_words.end());
-        return result;
+    document_texts_ = std::move(compacted);
+}
+
+void SearchServer::BuildExcludedSlots(const Query& query, DocumentSlot first_slot, DocumentSlot last_slot,
+                                      SlotBitmap& excluded) const {
+    excluded.Reset(first_slot, last_slot);
+    for (const TermId term_id : query.minus_terms) {
+        word_to_document_freqs_[term_id].ForEachInRange(first_slot, last_slot, [&excluded](DocumentSlot slot, double) {
+            excluded.Set(slot);
+        });
     }
-    else {
-        return result;
+}
+
+bool SearchServer::CanPruneQuery(const Query& query) const {
+    return std::all_of(query.plus_terms.begin(), query.plus_terms.end(), [this](TermId term_id) {
+        return word_to_document_freqs_[term_id].IsSorted();
+    });
+}
+
+bool SearchServer::HasTerm(TermId term_id, DocumentSlot slot) const {
+    return word_to_document_freqs_[term_id].Contains(slot);
+}
+
+void SearchServer::SetInverseDocumentFreqs(Query& query) const {
+    const double log_document_count = std::log(static_cast<double>(GetDocumentCount()));
+    query.inverse_document_freqs.resize(query.plus_terms.size());
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        query.inverse_document_freqs[i] = word_to_document_freqs_[query.plus_terms[i]].empty() ? 0.0
+            : ComputeWordInverseDocumentFreq(query.plus_terms[i], log_document_count);
+    }
+}
+
+void SearchServer::SetInverseDocumentFreqs(Query& query, const CollectionStatistics& statistics) const {
+    const double log_document_count = std::log(static_cast<double>(statistics.document_count));
+    query.inverse_document_freqs.resize(query.plus_terms.size());
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        // слово может встречаться только в документах, удалённых из коллекции, но не из этого сервера
+        const size_t document_freq = statistics.document_freq(dictionary_.GetWord(query.plus_terms[i]));
+        query.inverse_document_freqs[i] = document_freq == 0 ? 0.0
+            : log_document_count - std::log(static_cast<double>(document_freq));
     }
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id, double log_document_count) const {
+        return log_document_count - word_to_document_freqs_[term_id].GetLogSize();
     }
\ No newline at end of file
@@ -1,30 +1,74 @@
 #pragma once
 #include "string_processing.h"
 #include "document.h"
+#include "document_filter.h"
 #include "read_input_functions.h"
-#include "concurrent_map.h"
+#include "term_dictionary.h"
+#include "text_arena.h"
+#include "posting_list.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "index_snapshot.h"
+#include "query_cache.h"
+#include "query_executor.h"
+#include "document_fingerprint.h"
+#include "stop_word_filter.h"
+#include "thread_local_scratch.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <exception>
 #include <algorithm>
 #include <cmath>
 #include <execution>
+#include <numeric>
+#include <tuple>
+#include <thread>
 #include <vector>
 #include <deque>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 
 
 using namespace std::literals;
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
+// статистика всей коллекции для сервера, хранящего только её часть (сегмент):
+// idf плюс-слов считается по ней, а не по собственным счётчикам сервера
+struct CollectionStatistics {
+    size_t document_count = 0;
+    // число живых документов коллекции со словом
+    std::function<size_t(std::string_view word)> document_freq;
+};
+
 class SearchServer {
 public:
+    class QueryContext;
+
     template <typename StringContainer>
     explicit SearchServer(const StringContainer& stop_words);
     explicit SearchServer(const std::string_view stop_words_text);
     explicit SearchServer(const std::string& stop_word_text);
+    // открытие проверяет только заголовок и смещения; испорченный список вхождений или прямой индекс
+    // обнаруживается при первом обращении к слову или документу исключением runtime_error
+    explicit SearchServer(const IndexSnapshotPath& snapshot);
+
+    void Save(const std::string& path) const;
+
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    // пакетное добавление: разбор текстов и частичные индексы строятся параллельно
+    template <typename ExecutionPolicy, typename DocumentRange>
+    void AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents);
+
+    // переносит живые документы other, кроме skipped_ids, по их прямому индексу без повторного разбора текста.
+    // стоп-слова серверов должны совпадать
+    void AddDocumentsFrom(const SearchServer& other, const std::unordered_set<int>& skipped_ids);
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view raw_query,
                                       DocumentPredicate document_predicate) const;
@@ -33,6 +77,10 @@ public:
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
         DocumentPredicate document_predicate) const;
 
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                           const CollectionStatistics& statistics) const;
+
    
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
 
@@ -43,8 +91,50 @@ public:
     
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query) const;
+
+    // поиск в буферах context: после прогрева на похожих запросах память не выделяется.
+    // результат лежит в context и действителен до следующего поиска с ним; кэш запросов не используется
+    template <typename DocumentPredicate>
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, std::string_view raw_query,
+                                                  DocumentPredicate document_predicate) const;
+    const std::vector<Document>& FindTopDocuments(QueryContext& context, std::string_view raw_query,
+                                                  DocumentStatus status = DocumentStatus::ACTUAL) const;
     
     size_t GetDocumentCount() const;
+    // число живых документов со словом
+    size_t GetDocumentFreq(std::string_view word) const;
+
+    // грубая стоимость запроса для планировщика: суммарная длина списков плюс-слов
+    size_t EstimateQueryCost(std::string_view raw_query) const;
+
+    void SetMaxResultDocumentCount(size_t max_count);
+    size_t GetMaxResultDocumentCount() const;
+
+    // сжимает списки вхождений блоками по 128 без потери точности; изменение списка разворачивает его обратно
+    void CompressPostings();
+    template <typename ExecutionPolicy>
+    void CompressPostings(const ExecutionPolicy& policy);
+    size_t GetPostingsMemoryUsage() const;
+
+    // RemoveDocument не ищет документ в списках вхождений, а только помечает слот удалённым.
+    // PurgeRemovedDocuments выбрасывает записи удалённых документов и перенумеровывает живые слоты подряд.
+    // сам сервер его не вызывает: до вызова слоты и записи удалённых документов занимают память,
+    // поэтому при потоке удалений его зовут периодически вне пути запросов, например в период низкой нагрузки
+    void PurgeRemovedDocuments();
+    template <typename ExecutionPolicy>
+    void PurgeRemovedDocuments(const ExecutionPolicy& policy);
+
+    // при REJECT и FLAG у каждого документа считается отпечаток набора слов. REJECT отвергает документ
+    // с уже известным набором слов исключением invalid_argument, FLAG добавляет его, отмечая IsDuplicate
+    void SetDuplicatePolicy(DuplicatePolicy policy);
+    DuplicatePolicy GetDuplicatePolicy() const;
+    // есть живой документ с тем же набором слов и меньшим id; при ALLOW всегда false
+    bool IsDuplicate(int document_id) const;
+
+    // кэш результатов запросов с фильтром по статусу, вызовы с предикатом идут мимо него
+    void EnableQueryCache(size_t capacity);
+    void DisableQueryCache();
+    QueryCacheStats GetQueryCacheStats() const;
 
     std::set<int>::const_iterator begin() const;
     std::set<int>::const_iterator end() const;
@@ -61,122 +151,552 @@ public:
     DocTuple MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const;
     DocTuple MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query, int document_id) const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // собирается из прямого индекса при каждом вызове и возвращается по значению, а не ссылкой на
+    // хранимую карту, как раньше: код, державший ссылку между вызовами, должен хранить копию
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+    // отсортированные id уникальных слов документа; id действительны только в этом сервере
+    const MappableArray<TermId>& GetDocumentTerms(int document_id) const;
     
 private:
+    // холодная часть документа; id, рейтинг и статус лежат в document_columns_
     struct DocumentData {
-        int rating;
+        std::string_view text;
+        MappableArray<TermId> terms;
+        MappableArray<double> term_freqs;
+        DocumentFingerprint fingerprint;
+    };
+
+    // сводка блока слотов: границы id и рейтингов и статусы его документов. удаление документа
+    // сводку не сужает, она остаётся верной с запасом. блок совпадает со словом SlotBitmap
+    static constexpr size_t SLOT_BLOCK_SIZE = 64;
+    struct SlotBlockSummary {
+        int min_id;
+        int max_id;
+        int min_rating;
+        int max_rating;
+        // бит i - в блоке есть документ со статусом i
+        uint32_t status_mask;
+    };
+
+    // поля, нужные фильтру и выдаче, плотными столбцами по слотам: проверка вхождения
+    // читает один байт статуса и не трогает DocumentData
+    struct DocumentColumns {
+        std::vector<int> ids;
+        std::vector<int> ratings;
+        // DocumentStatus или REMOVED_STATUS
+        std::vector<uint8_t> statuses;
+        // сводка на каждые SLOT_BLOCK_SIZE слотов
+        std::vector<SlotBlockSummary> blocks;
+    };
+    // записи удалённого документа могут ещё лежать в списках вхождений до PurgeRemovedDocuments,
+    // такой статус не совпадает ни с одним DocumentStatus
+    static constexpr uint8_t REMOVED_STATUS = UINT8_MAX;
+    static constexpr DocumentSlot REMOVED_SLOT = UINT32_MAX;
+
+    // фильтр перегрузок FindTopDocuments по статусу: сравнивается байт столбца без вызова предиката
+    struct StatusFilter {
         DocumentStatus status;
-        std::string document_content;
     };
+
+    // DocumentFilter, приведённый к столбцам: списки id стали битовыми картами слотов
+    struct CompiledFilter {
+        uint32_t status_mask = UINT32_MAX;
+        int min_rating = INT_MIN;
+        int max_rating = INT_MAX;
+        int min_id = INT_MIN;
+        int max_id = INT_MAX;
+        bool has_id_range = false;
+        bool has_allowed_slots = false;
+        SlotBitmap allowed_slots{0, 0};
+        bool has_denied_slots = false;
+        SlotBitmap denied_slots{0, 0};
+        // бит блока слотов - сводка блока не исключает подходящих документов
+        SlotBitmap selectable_blocks{0, 0};
+        // пропуск блоков включается, только если фильтр хоть один блок отвергает
+        bool has_unselectable_blocks = false;
+    };
+    // предикат поиска с DocumentFilter; сам скомпилированный фильтр лежит в QueryContext
+    using CompiledFilterRef = std::reference_wrapper<const CompiledFilter>;
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double>> id_with_words_freq;
-    std::map<int, DocumentData> documents_;
+    // stop_words_, собранные для быстрой проверки слов документов и запросов
+    const StopWordFilter stop_word_filter_;
+    TermDictionary dictionary_;
+    std::vector<PostingList> word_to_document_freqs_;
+    std::vector<DocumentData> documents_;
+    DocumentColumns document_columns_;
+    TextArena document_texts_;
+    // растёт при каждом изменении набора документов и делает старые записи кэша промахами
+    uint64_t index_epoch_ = 0;
+    std::unique_ptr<QueryCache> query_cache_;
+    DuplicatePolicy duplicate_policy_ = DuplicatePolicy::ALLOW;
+    // документы с одинаковым отпечатком по возрастанию id; пусто при ALLOW
+    std::unordered_map<DocumentFingerprint, std::vector<int>, DocumentFingerprintHasher> fingerprint_documents_;
+    std::unordered_map<int, DocumentSlot> document_slots_;
     std::set<int> docs_index;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    // буфер слов AddDocument, чтобы не выделять память на каждый документ
+    std::vector<std::string_view> document_words_;
+    // документы, удалённые после последней чистки списков вхождений
+    size_t stale_document_count_ = 0;
+    // отображённый снимок, в который смотрят словарь и списки вхождений
+    std::shared_ptr<const MappedFile> index_file_;
+
+    // при открытии снимка проверяются заголовок и смещения, а слоты списков вхождений и id слов
+    // прямого индекса - при первом обращении к слову или документу. флаги общие у копий сервера
+    struct SnapshotChecks {
+        uint64_t term_count = 0;
+        uint64_t document_count = 0;
+        const uint64_t* posting_offsets = nullptr;
+        const DocumentSlot* posting_slots = nullptr;
+        const uint64_t* forward_offsets = nullptr;
+        const TermId* forward_terms = nullptr;
+        std::unique_ptr<std::atomic<bool>[]> checked_terms;
+        std::unique_ptr<std::atomic<bool>[]> checked_documents;
+    };
+    // пусто, когда сервер не из снимка или после перенумерации слотов всё уже проверено
+    std::shared_ptr<SnapshotChecks> snapshot_checks_;
+
+    explicit SearchServer(std::shared_ptr<const MappedFile> index_file);
+    static std::set<std::string, std::less<>> LoadStopWords(const MappedFile& index_file);
+
+    // бросают runtime_error, если список вхождений слова или прямой индекс документа в снимке испорчен
+    void CheckSnapshotTerm(TermId term_id) const;
+    void CheckSnapshotDocument(DocumentSlot slot) const;
+    // перед операциями над всем индексом
+    void CheckSnapshot() const;
 
     bool IsStopWord(std::string_view word) const;
 
     static bool IsValidWord(std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+    // слова text без стоп-слов в буфер words; бросает invalid_argument на слове с управляющим символом
+    void SplitIntoWordsNoStop(std::string_view text, std::vector<std::string_view>& words) const;
+
+    // индекс куска пакета со своим локальным словарём, слоты идут подряд с first_slot
+    struct PartialIndex {
+        std::vector<std::string_view> words;
+        std::vector<std::vector<std::pair<DocumentSlot, double>>> postings;
+        std::vector<std::vector<std::pair<TermId, double>>> document_terms;
+        std::vector<TermId> global_term_ids;
+        // заполняются, только если политика дубликатов не ALLOW
+        std::vector<DocumentFingerprint> fingerprints;
+        std::exception_ptr error;
+    };
+
+    void ValidateNewDocuments(const std::vector<const NewDocument*>& documents) const;
+    PartialIndex BuildPartialIndex(const std::vector<const NewDocument*>& documents, size_t first, size_t last,
+                                   DocumentSlot first_slot) const;
+    // переводит локальные словари в глобальный, возвращает (термин, кусок, локальный id) по возрастанию
+    std::vector<std::tuple<TermId, size_t, TermId>> InternPartialIndexes(std::vector<PartialIndex>& partial_indexes);
+    DocumentData MakeDocumentData(const PartialIndex& partial_index, size_t index) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    DocumentFingerprint ComputeFingerprint(const MappableArray<TermId>& terms) const;
+    // при REJECT бросает invalid_argument, если набор слов уже есть в индексе
+    void CheckDuplicate(int document_id, const DocumentFingerprint& fingerprint) const;
+    void RegisterFingerprint(DocumentSlot slot);
+    void UnregisterFingerprint(DocumentSlot slot);
+    // новый слот в конце: столбцы, прямой индекс, id и отпечаток
+    void AppendDocument(int document_id, int rating, DocumentStatus status, DocumentData document_data);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view text) const ;
+    // has_control_chars уже известен из разбора запроса на слова
+    QueryWord ParseQueryWord(std::string_view text, bool has_control_chars) const ;
 
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::vector<TermId> plus_terms;
+        std::vector<TermId> minus_terms;
+        // idf плюс-слов в том же порядке, заполняется перед поиском
+        std::vector<double> inverse_document_freqs;
     };
 
-    Query ParseQuery(std::string_view text, bool policy = 0) const ;
-   
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const ;
+    Query ParseQuery(std::string_view text) const ;
+    // в context.query_, слова запроса - в context.words_
+    void ParseQuery(std::string_view text, QueryContext& context) const;
 
+    DocumentSlot GetSlot(int document_id) const;
+    void ReleaseSlot(DocumentSlot slot);
+    // живой документ, проходящий фильтр
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query,
-                                      DocumentPredicate document_predicate) const;
+    bool IsDocumentSelected(DocumentSlot slot, const DocumentPredicate& document_predicate) const;
+    void CompileFilter(const DocumentFilter& filter, CompiledFilter& compiled) const;
+    // может ли в блоке найтись документ, проходящий фильтр
+    bool IsBlockSelectable(size_t block, const CompiledFilter& filter) const;
+    // блоки пропускаются только с DocumentFilter: про непрозрачный предикат ничего не известно.
+    // первый слот из [slot, last_slot) в блоке, который может пройти фильтр, иначе last_slot
+    template <typename DocumentPredicate>
+    DocumentSlot SkipUnselectableBlocks(DocumentSlot slot, DocumentSlot last_slot, const DocumentPredicate& document_predicate) const;
+    // первый слот из [slot, last_slot) в блоке, который фильтр заведомо отвергает, иначе last_slot
+    template <typename DocumentPredicate>
+    DocumentSlot FindUnselectableBlock(DocumentSlot slot, DocumentSlot last_slot, const DocumentPredicate& document_predicate) const;
+    // новые номера живых слотов по порядку, у удалённых - REMOVED_SLOT
+    std::vector<DocumentSlot> NumberLiveSlots() const;
+    // переносит документы и столбцы на новые номера слотов, списки вхождений уже перенумерованы
+    void CompactDocumentSlots(const std::vector<DocumentSlot>& new_slots);
+    void AppendDocumentColumns(int document_id, int rating, DocumentStatus status);
+    // переносит тексты живых документов в новую арену, отбрасывая байты удалённых
+    void CompactDocumentTexts();
+    bool HasTerm(TermId term_id, DocumentSlot slot) const;
+   
+    // log_document_count = ln(GetDocumentCount()) считается один раз на запрос
+    double ComputeWordInverseDocumentFreq(TermId term_id, double log_document_count) const ;
+    void SetInverseDocumentFreqs(Query& query) const;
+    void SetInverseDocumentFreqs(Query& query, const CollectionStatistics& statistics) const;
+
+    struct TermCursor {
+        PostingList::Cursor cursor;
+        double inverse_document_freq;
+        double max_score;
+        size_t query_index;
+    };
+
+    // буферы обработки одного диапазона слотов
+    struct RangeScratch {
+        SlotBitmap excluded{0, 0};
+        std::vector<TermCursor> terms;
+        std::vector<double> max_score_prefix;
+        std::vector<double> contributions;
+        DenseScoreAccumulator dense_scores{0, 0};
+        HashScoreAccumulator hash_scores{0};
+    };
 
+    // запрос берётся из context.query_, результат кладётся в context.result_
     template <typename ExecutionPolicy, typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy,
-        const Query& query, DocumentPredicate document_predicate) const;
+    void FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context,
+                                  DocumentPredicate document_predicate) const;
+    // условия фильтра сводятся к столбцам и битовым картам в context.filter_
+    template <typename ExecutionPolicy>
+    void FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context, const DocumentFilter& filter) const;
+
+    // все подходящие документы в context.matched_documents_
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    void FindAllDocuments(const ExecutionPolicy& policy, QueryContext& context, DocumentPredicate document_predicate) const;
+
+    // дописывает найденные документы в matched_documents
+    template <typename DocumentPredicate>
+    void FindDocumentsInRange(const Query& query, DocumentPredicate document_predicate, DocumentSlot first_slot,
+                              DocumentSlot last_slot, RangeScratch& scratch, std::vector<Document>& matched_documents) const;
+
+    void BuildExcludedSlots(const Query& query, DocumentSlot first_slot, DocumentSlot last_slot, SlotBitmap& excluded) const;
+
+    // отсечение MaxScore требует, чтобы списки плюс-слов можно было обходить курсором
+    bool CanPruneQuery(const Query& query) const;
+
+    // документ за документом по курсорам плюс-слов; документы, которые не могут попасть в кучу,
+    // отбрасываются по сумме верхних границ max_tf * idf без полного подсчёта
+    template <typename DocumentPredicate>
+    void FindTopDocumentsInRange(const Query& query, DocumentPredicate document_predicate, DocumentSlot first_slot,
+                                 DocumentSlot last_slot, RangeScratch& scratch, TopDocumentsHeap& heap) const;
+};
+
+// буферы одного запроса: слова, термины, курсоры, накопители и результат. поиск только
+// перезаписывает их, поэтому после первых запросов их ёмкости хватает и память не выделяется.
+// контекст нельзя использовать из нескольких потоков одновременно
+class SearchServer::QueryContext {
+public:
+    QueryContext() = default;
+
+private:
+    friend class SearchServer;
+
+    std::vector<std::string_view> words_;
+    Query query_;
+    RangeScratch range_;
+    TopDocumentsHeap heap_{0};
+    std::vector<Document> matched_documents_;
+    // по одному на кусок параллельного поиска; не укорачиваются, чтобы не терять память
+    std::vector<TopDocumentsHeap> chunk_heaps_;
+    std::vector<std::vector<Document>> chunk_documents_;
+    std::vector<Document> result_;
+    CompiledFilter filter_;
 };
 
  template <typename StringContainer>
     SearchServer::SearchServer(const StringContainer& stop_words)
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) 
+        , stop_word_filter_(stop_words_)
     {
         if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
             throw std::invalid_argument("Some of stop words are invalid"s);
         }
     }
 
- const uint32_t epsilon = 1e-6;
-   
 template <typename DocumentPredicate>
 std::vector<Document>  SearchServer::FindTopDocuments( std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    auto matched_documents = SearchServer::FindAllDocuments(query, document_predicate);
-    sort(matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
-                    return lhs.rating > rhs.rating;
-                } else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-    return matched_documents;
+    return SearchServer::FindTopDocuments(std::execution::seq, raw_query, document_predicate);
 }
 
 template <typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
     DocumentPredicate document_predicate) const {
+    ThreadLocalScratch<QueryContext> context;
+    ParseQuery(raw_query, *context);
+    SetInverseDocumentFreqs(context->query_);
+    SearchServer::FindTopDocumentsForQuery(policy, *context, document_predicate);
+    return context->result_;
+}
+
+template <typename DocumentPredicate>
+const std::vector<Document>& SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query,
+                                                            DocumentPredicate document_predicate) const {
+    ParseQuery(raw_query, context);
+    SetInverseDocumentFreqs(context.query_);
+    SearchServer::FindTopDocumentsForQuery(std::execution::seq, context, document_predicate);
+    return context.result_;
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                                                     const CollectionStatistics& statistics) const {
+    ThreadLocalScratch<QueryContext> context;
+    ParseQuery(raw_query, *context);
+    SetInverseDocumentFreqs(context->query_, statistics);
+    SearchServer::FindTopDocumentsForQuery(std::execution::seq, *context, document_predicate);
+    return context->result_;
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context,
+                                            const DocumentFilter& filter) const {
+    CompileFilter(filter, context.filter_);
+    SearchServer::FindTopDocumentsForQuery(policy, context, CompiledFilterRef(context.filter_));
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindTopDocumentsForQuery(const ExecutionPolicy& policy, QueryContext& context,
+    DocumentPredicate document_predicate) const {
+    const Query& query = context.query_;
+    const size_t slot_count = documents_.size();
+    if (!CanPruneQuery(query)) {
+        SearchServer::FindAllDocuments(policy, context, document_predicate);
+        if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+            context.heap_.Reset(max_result_document_count_);
+            for (const Document& document : context.matched_documents_) {
+                context.heap_.Push(document);
+            }
+            context.heap_.ExtractTo(context.result_);
+        }
+        else {
+            context.result_ = SelectTopDocuments(policy, context.matched_documents_, max_result_document_count_);
+        }
+        return;
+    }
     if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        return SearchServer::FindTopDocuments(raw_query, document_predicate);
+        context.heap_.Reset(max_result_document_count_);
+        SearchServer::FindTopDocumentsInRange(query, document_predicate, 0, static_cast<DocumentSlot>(slot_count),
+                                              context.range_, context.heap_);
+        context.heap_.ExtractTo(context.result_);
     }
     else {
-        const auto query = ParseQuery(raw_query);
-        auto matched_documents = SearchServer::FindAllDocuments(policy, query, document_predicate);
-        std::sort(policy, matched_documents.begin(), matched_documents.end(),
-            [](const Document& lhs, const Document& rhs) {
-                if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
-                    return lhs.rating > rhs.rating;
-                }
-                else {
-                    return lhs.relevance > rhs.relevance;
-                }
-            });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        // у каждого диапазона слотов своя куча и свой порог отсечения, кучи затем сливаются
+        const size_t min_chunk_slots = 4096;
+        const size_t chunk_count = std::max<size_t>(1, std::min<size_t>(
+            GetParallelism(policy), slot_count / min_chunk_slots));
+        std::vector<TopDocumentsHeap>& heaps = context.chunk_heaps_;
+        if (heaps.size() < chunk_count) {
+            heaps.resize(chunk_count, TopDocumentsHeap(0));
+        }
+        ForEachIndex(policy, chunk_count, [&, document_predicate](size_t chunk) {
+            const auto first_slot = static_cast<DocumentSlot>(slot_count * chunk / chunk_count);
+            const auto last_slot = static_cast<DocumentSlot>(slot_count * (chunk + 1) / chunk_count);
+            // куски выполняются в разных потоках, буферы диапазона у каждого потока свои
+            ThreadLocalScratch<RangeScratch> scratch;
+            heaps[chunk].Reset(max_result_document_count_);
+            SearchServer::FindTopDocumentsInRange(query, document_predicate, first_slot, last_slot, *scratch, heaps[chunk]);
+        });
+        for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+            heaps[0].Merge(heaps[chunk]);
         }
-        return matched_documents;
+        heaps[0].ExtractTo(context.result_);
     }
 }
  
+template <typename ExecutionPolicy>
+void SearchServer::CompressPostings(const ExecutionPolicy& policy) {
+    CheckSnapshot();
+    std::for_each(policy, word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [](PostingList& postings) {
+        postings.Compress();
+    });
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::PurgeRemovedDocuments(const ExecutionPolicy& policy) {
+    if (stale_document_count_ == 0) {
+        return;
+    }
+    CheckSnapshot();
+    const std::vector<DocumentSlot> new_slots = NumberLiveSlots();
+    std::for_each(policy, word_to_document_freqs_.begin(), word_to_document_freqs_.end(), [&new_slots](PostingList& postings) {
+        postings.PurgeStale([&new_slots](DocumentSlot slot) {
+            return new_slots[slot] == REMOVED_SLOT;
+        });
+        postings.RenumberSlots(new_slots);
+    });
+    CompactDocumentSlots(new_slots);
+}
+
+template <typename ExecutionPolicy, typename DocumentRange>
+void SearchServer::AddDocuments(const ExecutionPolicy& policy, const DocumentRange& documents) {
+    std::vector<const NewDocument*> batch;
+    for (const NewDocument& document : documents) {
+        batch.push_back(&document);
+    }
+    ValidateNewDocuments(batch);
+
+    const size_t min_chunk_size = 256;
+    size_t chunk_count = 1;
+    if constexpr (!std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        chunk_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), batch.size() / min_chunk_size));
+    }
+    const auto first_slot = static_cast<DocumentSlot>(documents_.size());
+    std::vector<PartialIndex> partial_indexes(chunk_count);
+    std::vector<size_t> chunks(chunk_count);
+    std::iota(chunks.begin(), chunks.end(), 0);
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        const size_t first = batch.size() * chunk / chunk_count;
+        const size_t last = batch.size() * (chunk + 1) / chunk_count;
+        partial_indexes[chunk] = BuildPartialIndex(batch, first, last, static_cast<DocumentSlot>(first_slot + first));
+    });
+    for (const PartialIndex& partial_index : partial_indexes) {
+        if (partial_index.error) {
+            std::rethrow_exception(partial_index.error);
+        }
+    }
+    if (duplicate_policy_ == DuplicatePolicy::REJECT) {
+        // повторы внутри пакета отвергаются так же, как повторы уже добавленных документов
+        std::unordered_set<DocumentFingerprint, DocumentFingerprintHasher> batch_fingerprints;
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            const size_t first = batch.size() * chunk / chunk_count;
+            for (size_t i = 0; i < partial_indexes[chunk].fingerprints.size(); ++i) {
+                const DocumentFingerprint& fingerprint = partial_indexes[chunk].fingerprints[i];
+                CheckDuplicate(batch[first + i]->id, fingerprint);
+                if (!batch_fingerprints.insert(fingerprint).second) {
+                    throw std::invalid_argument("Document "s + std::to_string(batch[first + i]->id) + " is a duplicate"s);
+                }
+            }
+        }
+    }
+
+    // куски покрывают возрастающие непересекающиеся диапазоны слотов, поэтому слияние
+    // k списков одного термина сводится к их дописыванию в порядке кусков
+    const auto term_sources = InternPartialIndexes(partial_indexes);
+    word_to_document_freqs_.resize(dictionary_.size());
+    std::vector<size_t> term_starts;
+    for (size_t i = 0; i < term_sources.size(); ++i) {
+        if (i == 0 || std::get<0>(term_sources[i]) != std::get<0>(term_sources[i - 1])) {
+            term_starts.push_back(i);
+        }
+    }
+    std::for_each(policy, term_starts.begin(), term_starts.end(), [&](size_t start) {
+        const TermId term_id = std::get<0>(term_sources[start]);
+        for (size_t i = start; i < term_sources.size() && std::get<0>(term_sources[i]) == term_id; ++i) {
+            const auto& [_, chunk, local_term_id] = term_sources[i];
+            for (const auto& [slot, term_freq] : partial_indexes[chunk].postings[local_term_id]) {
+                word_to_document_freqs_[term_id].Add(slot, term_freq);
+            }
+        }
+    });
+
+    std::vector<DocumentData> new_documents(batch.size());
+    std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+        const size_t first = batch.size() * chunk / chunk_count;
+        const size_t last = batch.size() * (chunk + 1) / chunk_count;
+        for (size_t i = first; i < last; ++i) {
+            new_documents[i] = MakeDocumentData(partial_indexes[chunk], i - first);
+        }
+    });
+    ++index_epoch_;
+    documents_.reserve(documents_.size() + new_documents.size());
+    for (size_t i = 0; i < new_documents.size(); ++i) {
+        DocumentData& document_data = new_documents[i];
+        document_data.text = document_texts_.Store(batch[i]->text);
+        AppendDocument(batch[i]->id, ComputeAverageRating(batch[i]->ratings), batch[i]->status, std::move(document_data));
+    }
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::IsDocumentSelected(DocumentSlot slot, const DocumentPredicate& document_predicate) const {
+    const uint8_t status = document_columns_.statuses[slot];
+    if constexpr (std::is_same_v<DocumentPredicate, StatusFilter>) {
+        return status == static_cast<uint8_t>(document_predicate.status);
+    }
+    else if constexpr (std::is_same_v<DocumentPredicate, CompiledFilterRef>) {
+        // столбец id читается, только если по нему есть условие
+        const CompiledFilter& filter = document_predicate.get();
+        const int rating = document_columns_.ratings[slot];
+        return rating >= filter.min_rating && rating <= filter.max_rating
+            && status != REMOVED_STATUS && ((filter.status_mask >> status) & 1) != 0
+            && (!filter.has_id_range || (document_columns_.ids[slot] >= filter.min_id && document_columns_.ids[slot] <= filter.max_id))
+            && (!filter.has_allowed_slots || filter.allowed_slots.Test(slot))
+            && (!filter.has_denied_slots || !filter.denied_slots.Test(slot));
+    }
+    else {
+        return status != REMOVED_STATUS && document_predicate(document_columns_.ids[slot],
+            static_cast<DocumentStatus>(status), document_columns_.ratings[slot]);
+    }
+}
+
+template <typename DocumentPredicate>
+DocumentSlot SearchServer::SkipUnselectableBlocks(DocumentSlot slot, DocumentSlot last_slot,
+                                                  const DocumentPredicate& document_predicate) const {
+    if constexpr (std::is_same_v<DocumentPredicate, CompiledFilterRef>) {
+        const CompiledFilter& filter = document_predicate.get();
+        if (!filter.has_unselectable_blocks) {
+            return slot;
+        }
+        for (size_t block = slot / SLOT_BLOCK_SIZE; slot < last_slot && !filter.selectable_blocks.Test(block);) {
+            ++block;
+            slot = static_cast<DocumentSlot>(std::min<size_t>(block * SLOT_BLOCK_SIZE, last_slot));
+        }
+    }
+    return slot;
+}
+
+template <typename DocumentPredicate>
+DocumentSlot SearchServer::FindUnselectableBlock(DocumentSlot slot, DocumentSlot last_slot,
+                                                 const DocumentPredicate& document_predicate) const {
+    if constexpr (std::is_same_v<DocumentPredicate, CompiledFilterRef>) {
+        const CompiledFilter& filter = document_predicate.get();
+        if (!filter.has_unselectable_blocks) {
+            return last_slot;
+        }
+        for (size_t block = slot / SLOT_BLOCK_SIZE; slot < last_slot && filter.selectable_blocks.Test(block);) {
+            ++block;
+            slot = static_cast<DocumentSlot>(std::min<size_t>(block * SLOT_BLOCK_SIZE, last_slot));
+        }
+        return slot;
+    }
+    else {
+        return last_slot;
+    }
+}
+
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy,
                                                     std::string_view raw_query,
                                                     DocumentStatus status) const {
-    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
-        return SearchServer::FindTopDocuments(raw_query, status);
+    ThreadLocalScratch<QueryContext> context;
+    ParseQuery(raw_query, *context);
+    const Query& query = context->query_;
+    const StatusFilter predicate{status};
+    SetInverseDocumentFreqs(context->query_);
+    if (!query_cache_) {
+        SearchServer::FindTopDocumentsForQuery(policy, *context, predicate);
+        return context->result_;
     }
-    else {
-        return SearchServer::FindTopDocuments(policy
-            , raw_query
-            , [status](int document_id, DocumentStatus document_status, int rating) {
-            return document_status == status;
-            });
+    QueryCacheKey key{query.plus_terms, query.minus_terms, status, max_result_document_count_};
+    if (auto cached = query_cache_->Find(key, index_epoch_)) {
+        return std::move(*cached);
     }
+    SearchServer::FindTopDocumentsForQuery(policy, *context, predicate);
+    query_cache_->Insert(std::move(key), index_epoch_, context->result_);
+    return context->result_;
 }
 
 template <typename ExecutionPolicy>
@@ -189,76 +709,191 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
     }
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+template <typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const ExecutionPolicy& policy, QueryContext& context, DocumentPredicate document_predicate) const {
+    const Query& query = context.query_;
+    const size_t slot_count = documents_.size();
+    std::vector<Document>& matched_documents = context.matched_documents_;
+    matched_documents.clear();
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        SearchServer::FindDocumentsInRange(query, document_predicate, 0, static_cast<DocumentSlot>(slot_count),
+                                           context.range_, matched_documents);
+    }
+    else {
+        // слоты делятся на непересекающиеся диапазоны, у каждого потока свой накопитель,
+        // поэтому блокировки не нужны, а результаты просто склеиваются
+        const size_t min_chunk_slots = 4096;
+        const size_t chunk_count = std::max<size_t>(1, std::min<size_t>(
+            GetParallelism(policy), slot_count / min_chunk_slots));
+        std::vector<std::vector<Document>>& chunk_documents = context.chunk_documents_;
+        if (chunk_documents.size() < chunk_count) {
+            chunk_documents.resize(chunk_count);
+        }
+        ForEachIndex(policy, chunk_count, [&, document_predicate](size_t chunk) {
+            const auto first_slot = static_cast<DocumentSlot>(slot_count * chunk / chunk_count);
+            const auto last_slot = static_cast<DocumentSlot>(slot_count * (chunk + 1) / chunk_count);
+            ThreadLocalScratch<RangeScratch> scratch;
+            chunk_documents[chunk].clear();
+            SearchServer::FindDocumentsInRange(query, document_predicate, first_slot, last_slot, *scratch, chunk_documents[chunk]);
+        });
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+            matched_documents.insert(matched_documents.end(), chunk_documents[chunk].begin(), chunk_documents[chunk].end());
         }
-        const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindDocumentsInRange(const Query& query, DocumentPredicate document_predicate, DocumentSlot first_slot,
+                                        DocumentSlot last_slot, RangeScratch& scratch, std::vector<Document>& matched_documents) const {
+    const SlotBitmap& excluded = scratch.excluded;
+    BuildExcludedSlots(query, first_slot, last_slot, scratch.excluded);
+
+    size_t candidate_count = 0;
+    for (const TermId term_id : query.plus_terms) {
+        candidate_count += word_to_document_freqs_[term_id].size();
+    }
+    const size_t slot_count = documents_.size();
+    candidate_count = slot_count == 0 ? 0 : candidate_count * (last_slot - first_slot) / slot_count;
+
+    auto collect = [&](auto& accumulator) {
+        for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+            const TermId term_id = query.plus_terms[i];
+            if (word_to_document_freqs_[term_id].empty()) {
+                continue;
+            }
+            const double inverse_document_freq = query.inverse_document_freqs[i];
+            // списки обходятся только по участкам из блоков, которые могут пройти фильтр
+            DocumentSlot run_first = SkipUnselectableBlocks(first_slot, last_slot, document_predicate);
+            while (run_first < last_slot) {
+                const DocumentSlot run_last = FindUnselectableBlock(run_first, last_slot, document_predicate);
+                word_to_document_freqs_[term_id].ForEachInRange(run_first, run_last, [&](DocumentSlot slot, double term_freq) {
+                    if (excluded.Test(slot)) {
+                        return;
+                    }
+                    if (IsDocumentSelected(slot, document_predicate)) {
+                        accumulator.Add(slot, term_freq * inverse_document_freq);
+                    }
+                });
+                run_first = SkipUnselectableBlocks(run_last, last_slot, document_predicate);
             }
         }
+        accumulator.ForEach([&](DocumentSlot slot, double relevance) {
+            matched_documents.push_back({ document_columns_.ids[slot], relevance, document_columns_.ratings[slot] });
+        });
+    };
+    // плотный массив окупается, когда кандидатов хотя бы 1/8 от диапазона
+    if (candidate_count * 8 >= last_slot - first_slot) {
+        scratch.dense_scores.Reset(first_slot, last_slot);
+        collect(scratch.dense_scores);
+    }
+    else {
+        scratch.hash_scores.Reset(candidate_count);
+        collect(scratch.hash_scores);
     }
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocumentsInRange(const Query& query, DocumentPredicate document_predicate, DocumentSlot first_slot,
+                                           DocumentSlot last_slot, RangeScratch& scratch, TopDocumentsHeap& heap) const {
+    const SlotBitmap& excluded = scratch.excluded;
+    BuildExcludedSlots(query, first_slot, last_slot, scratch.excluded);
+
+    std::vector<TermCursor>& terms = scratch.terms;
+    terms.clear();
+    for (size_t i = 0; i < query.plus_terms.size(); ++i) {
+        const PostingList& postings = word_to_document_freqs_[query.plus_terms[i]];
+        if (postings.empty()) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        PostingList::Cursor cursor(postings, first_slot, last_slot);
+        if (cursor.AtEnd()) {
+            continue;
         }
+        const double inverse_document_freq = query.inverse_document_freqs[i];
+        terms.push_back({cursor, inverse_document_freq, postings.GetMaxTermFreq() * inverse_document_freq, i});
     }
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            {document_id, relevance, documents_.at(document_id).rating});
+    // по возрастанию верхней границы: слова с начала списка первыми становятся необязательными
+    std::sort(terms.begin(), terms.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_score < rhs.max_score;
+    });
+    std::vector<double>& max_score_prefix = scratch.max_score_prefix;
+    max_score_prefix.resize(terms.size());
+    for (size_t i = 0; i < terms.size(); ++i) {
+        max_score_prefix[i] = (i == 0 ? 0.0 : max_score_prefix[i - 1]) + terms[i].max_score;
     }
-    return matched_documents;
-}
 
-template <typename ExecutionPolicy, typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(7);
-    for_each(policy
-        , query.plus_words.begin()
-        , query.plus_words.end()
-        , [&, document_predicate] (auto word) {
-                if (word_to_document_freqs_.count(word) != 0) {
-                    const double inverse_document_freq = SearchServer::ComputeWordInverseDocumentFreq(word);
-                    for_each(policy,
-                            word_to_document_freqs_.at(word).begin(),
-                            word_to_document_freqs_.at(word).end(),
-                            [&document_to_relevance, this, &document_predicate, &inverse_document_freq](const auto& info_) {
-                            const auto& document_data = documents_.at(info_.first);
-                            if (document_predicate(info_.first, document_data.status, document_data.rating)) {
-                                document_to_relevance[info_.first].ref_to_value += info_.second * inverse_document_freq;
-                            }
-                    });
+    // документ, встречающийся только в словах [0, first_essential), не превысит порог.
+    // порог взят с запасом RELEVANCE_EPSILON: документ ниже него заведомо хуже худшего в куче
+    double threshold = -INFINITY;
+    size_t first_essential = 0;
+    // вклады складываются в порядке слов запроса, как в FindDocumentsInRange, чтобы релевантность совпадала до бита
+    std::vector<double>& contributions = scratch.contributions;
+    contributions.assign(query.plus_terms.size(), 0.0);
+    // до этого слота блоки подряд могут пройти фильтр и сводки не проверяются
+    DocumentSlot selectable_run_end = FindUnselectableBlock(first_slot, last_slot, document_predicate);
+    while (first_essential < terms.size()) {
+        DocumentSlot slot = last_slot;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            if (!terms[i].cursor.AtEnd()) {
+                slot = std::min(slot, terms[i].cursor.Slot());
+            }
+        }
+        if (slot == last_slot) {
+            break;
+        }
+        // блоки, которые фильтр отвергает целиком, курсоры обязательных слов перепрыгивают без раскодирования
+        if (slot >= selectable_run_end) {
+            const DocumentSlot selectable_slot = SkipUnselectableBlocks(slot, last_slot, document_predicate);
+            if (selectable_slot != slot) {
+                for (size_t i = first_essential; i < terms.size(); ++i) {
+                    terms[i].cursor.SkipTo(selectable_slot);
                 }
+                continue;
             }
-    );
-    for_each(policy
-        , query.minus_words.begin()
-        , query.minus_words.end()
-        , [&](const auto& word) {
-            if (word_to_document_freqs_.count(word) != 0) {
-                for_each(policy,
-                        word_to_document_freqs_.at(word).begin(),
-                        word_to_document_freqs_.at(word).end(),
-                        [&document_to_relevance, this, &word](const auto& info_) {
-                        document_to_relevance.Delete(info_.first);
-                });
+            selectable_run_end = FindUnselectableBlock(slot, last_slot, document_predicate);
+        }
+        // документ, не прошедший фильтр, только пропускается курсорами, вклады не считаются
+        const bool is_selected = !excluded.Test(slot) && IsDocumentSelected(slot, document_predicate);
+        double score = 0.0;
+        for (size_t i = first_essential; i < terms.size(); ++i) {
+            PostingList::Cursor& cursor = terms[i].cursor;
+            if (!cursor.AtEnd() && cursor.Slot() == slot) {
+                if (is_selected) {
+                    contributions[terms[i].query_index] = cursor.TermFreq() * terms[i].inverse_document_freq;
+                    score += contributions[terms[i].query_index];
+                }
+                cursor.Next();
             }
-        });        
-    std::vector<Document> matched_documents;
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+        }
+        if (!is_selected) {
+            continue;
+        }
+        bool is_candidate = true;
+        for (size_t i = first_essential; is_candidate && i-- > 0;) {
+            if (score + max_score_prefix[i] < threshold) {
+                is_candidate = false;
+                break;
+            }
+            PostingList::Cursor& cursor = terms[i].cursor;
+            cursor.SkipTo(slot);
+            if (!cursor.AtEnd() && cursor.Slot() == slot) {
+                contributions[terms[i].query_index] = cursor.TermFreq() * terms[i].inverse_document_freq;
+                score += contributions[terms[i].query_index];
+            }
+        }
+        if (is_candidate && score >= threshold) {
+            double relevance = 0.0;
+            for (const double contribution : contributions) {
+                relevance += contribution;
+            }
+            heap.Push({ document_columns_.ids[slot], relevance, document_columns_.ratings[slot] });
+            if (heap.IsFull()) {
+                threshold = heap.Worst().relevance - RELEVANCE_EPSILON;
+                while (first_essential < terms.size() && max_score_prefix[first_essential] < threshold) {
+                    ++first_essential;
+                }
+            }
+        }
+        std::fill(contributions.begin(), contributions.end(), 0.0);
     }
-    return matched_documents;
 }
-    
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "test_example_functions.h"
+#include "test_framework.h"
+
+#include <string>
+
+using namespace std::literals;
+
+// тестовая программа: собирается проектом SearchServerTests вместе с заменой operator new.
+// с аргументом benchmark после тестов запускаются замеры
+int main(int argc, char* argv[]) {
+    {
+        TestRunner tr;
+        RUN_TEST(tr, TestQueryContextDoesNotAllocate);
+        RUN_TEST(tr, TestNearDuplicatesAreNotChained);
+        RUN_TEST(tr, TestPurgeRemovedDocumentsKeepsResults);
+        RUN_TEST(tr, TestSnapshotChecksPostingsOnFirstUse);
+        RUN_TEST(tr, TestSnapshotRoundTrip);
+        RUN_TEST(tr, TestConcurrentSearchServerPublish);
+        RUN_TEST(tr, TestSegmentedSearchServerMatchesSingleServer);
+    }
+    if (argc > 1 && argv[1] == "benchmark"s) {
+        BenchmarkConcurrentMap();
+    }
+    return 0;
+}
\ No newline at end of file
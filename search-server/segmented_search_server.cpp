@@ -0,0 +1,225 @@
+#include "segmented_search_server.h"
+
+#include <algorithm>
+
+SegmentedSearchServer::SegmentedSearchServer(std::string_view stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options) {
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const std::string& stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options) {
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        std::lock_guard guard(merge_mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    merger_.join();
+}
+
+size_t SegmentedSearchServer::Segment::GetLiveCount() const {
+    return server->GetDocumentCount() - deleted_ids.size();
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                                        const std::vector<int>& ratings) {
+    std::unique_lock lock(mutex_);
+    if (document_id < 0 || document_segments_.count(document_id) > 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    mutable_segment_->AddDocument(document_id, document, status, ratings);
+    document_segments_.emplace(document_id, nullptr);
+    if (mutable_segment_->GetDocumentCount() >= std::max<size_t>(1, options_.max_mutable_documents)) {
+        SealMutableSegment();
+        lock.unlock();
+        RequestMerge();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    std::unique_lock lock(mutex_);
+    const auto it = document_segments_.find(document_id);
+    if (it == document_segments_.end()) {
+        return;
+    }
+    const std::shared_ptr<Segment> segment = it->second;
+    document_segments_.erase(it);
+    if (!segment) {
+        mutable_segment_->RemoveDocument(document_id);
+        return;
+    }
+    MarkDeleted(*segment, document_id);
+    // сегмент, наполовину состоящий из удалённых, переписывается без них
+    if (segment->deleted_ids.size() * 2 > segment->server->GetDocumentCount()) {
+        lock.unlock();
+        RequestMerge();
+    }
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+size_t SegmentedSearchServer::GetDocumentCount() const {
+    std::shared_lock lock(mutex_);
+    return document_segments_.size();
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    std::shared_lock lock(mutex_);
+    return segments_.size();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    std::unique_lock lock(merge_mutex_);
+    merge_cv_.wait(lock, [this] {
+        return !merge_requested_ && !merging_;
+    });
+}
+
+void SegmentedSearchServer::SealMutableSegment() {
+    auto segment = std::make_shared<Segment>();
+    segment->server = std::move(mutable_segment_);
+    mutable_segment_ = std::make_unique<SearchServer>(stop_words_);
+    for (const int document_id : *segment->server) {
+        document_segments_[document_id] = segment;
+    }
+    segments_.push_back(std::move(segment));
+}
+
+void SegmentedSearchServer::RequestMerge() {
+    {
+        std::lock_guard guard(merge_mutex_);
+        merge_requested_ = true;
+    }
+    merge_cv_.notify_all();
+}
+
+void SegmentedSearchServer::MarkDeleted(Segment& segment, int document_id) {
+    segment.deleted_ids.insert(document_id);
+    for (const auto& [word, term_freq] : segment.server->GetWordFrequencies(document_id)) {
+        const auto it = segment.deleted_document_freqs.find(word);
+        if (it == segment.deleted_document_freqs.end()) {
+            segment.deleted_document_freqs.emplace(std::string(word), 1);
+        }
+        else {
+            ++it->second;
+        }
+    }
+}
+
+size_t SegmentedSearchServer::GetTier(size_t document_count) const {
+    const size_t merge_factor = std::max<size_t>(2, options_.merge_factor);
+    size_t tier = 0;
+    for (size_t limit = std::max<size_t>(1, options_.max_mutable_documents); document_count > limit; limit *= merge_factor) {
+        ++tier;
+    }
+    return tier;
+}
+
+std::vector<std::shared_ptr<SegmentedSearchServer::Segment>> SegmentedSearchServer::SelectMergeSources() const {
+    const size_t merge_factor = std::max<size_t>(2, options_.merge_factor);
+    std::map<size_t, std::vector<std::shared_ptr<Segment>>> tiers;
+    for (const auto& segment : segments_) {
+        if (segment->deleted_ids.size() * 2 > segment->server->GetDocumentCount()) {
+            return {segment};
+        }
+        auto& tier = tiers[GetTier(segment->GetLiveCount())];
+        tier.push_back(segment);
+        if (tier.size() == merge_factor) {
+            return tier;
+        }
+    }
+    return {};
+}
+
+bool SegmentedSearchServer::MergeOnce() {
+    std::vector<std::shared_ptr<Segment>> sources;
+    std::vector<std::unordered_set<int>> deleted_ids;
+    {
+        std::shared_lock lock(mutex_);
+        sources = SelectMergeSources();
+        for (const auto& source : sources) {
+            deleted_ids.push_back(source->deleted_ids);
+        }
+    }
+    if (sources.empty()) {
+        return false;
+    }
+
+    // закрытые сегменты не меняются, поэтому сливаются без блокировки параллельно с запросами
+    auto merged_server = std::make_unique<SearchServer>(stop_words_);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        merged_server->AddDocumentsFrom(*sources[i]->server, deleted_ids[i]);
+    }
+    auto merged = std::make_shared<Segment>();
+    merged->server = std::move(merged_server);
+
+    std::unique_lock lock(mutex_);
+    // удаления, пришедшие во время слияния, переносятся в новый сегмент
+    for (size_t i = 0; i < sources.size(); ++i) {
+        for (const int document_id : sources[i]->deleted_ids) {
+            if (deleted_ids[i].count(document_id) == 0) {
+                MarkDeleted(*merged, document_id);
+            }
+        }
+    }
+    for (const int document_id : *merged->server) {
+        if (merged->deleted_ids.count(document_id) == 0) {
+            document_segments_[document_id] = merged;
+        }
+    }
+    segments_.erase(std::remove_if(segments_.begin(), segments_.end(), [&sources](const auto& segment) {
+        return std::find(sources.begin(), sources.end(), segment) != sources.end();
+    }), segments_.end());
+    segments_.push_back(std::move(merged));
+    return true;
+}
+
+void SegmentedSearchServer::MergeLoop() {
+    while (true) {
+        {
+            std::unique_lock lock(merge_mutex_);
+            merge_cv_.wait(lock, [this] {
+                return stopping_ || merge_requested_;
+            });
+            if (stopping_) {
+                return;
+            }
+            merge_requested_ = false;
+            merging_ = true;
+        }
+        while (!stopping_ && MergeOnce()) {
+        }
+        {
+            std::lock_guard guard(merge_mutex_);
+            merging_ = false;
+        }
+        merge_cv_.notify_all();
+    }
+}
+
+CollectionStatistics SegmentedSearchServer::MakeStatistics() const {
+    CollectionStatistics statistics;
+    statistics.document_count = document_segments_.size();
+    statistics.document_freq = [this](std::string_view word) {
+        size_t document_freq = mutable_segment_->GetDocumentFreq(word);
+        for (const auto& segment : segments_) {
+            document_freq += segment->server->GetDocumentFreq(word);
+            const auto it = segment->deleted_document_freqs.find(word);
+            if (it != segment->deleted_document_freqs.end()) {
+                document_freq -= it->second;
+            }
+        }
+        return document_freq;
+    };
+    return statistics;
+}
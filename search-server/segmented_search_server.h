@@ -0,0 +1,124 @@
+#pragma once
+#include "search_server.h"
+#include "top_documents.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct SegmentOptions {
+    // изменяемый сегмент с таким числом документов закрывается и становится неизменяемым
+    size_t max_mutable_documents = 4096;
+    // столько сегментов одного яруса сливаются в один
+    size_t merge_factor = 4;
+};
+
+// индекс как набор сегментов: документы добавляются в маленький изменяемый SearchServer,
+// заполненный сегмент закрывается, удаление из закрытого только отмечает id. фоновый поток
+// сливает по merge_factor сегментов одного яруса (ярус k - до max_mutable_documents * merge_factor^k
+// живых документов), отбрасывая удалённые. запрос идёт во все сегменты с общей статистикой
+// коллекции, поэтому релевантность та же, что у одного SearchServer, а лучшие K сливаются.
+// методы можно вызывать из разных потоков: запросы выполняются параллельно друг с другом
+class SegmentedSearchServer {
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, SegmentOptions options = {});
+    explicit SegmentedSearchServer(std::string_view stop_words_text, SegmentOptions options = {});
+    explicit SegmentedSearchServer(const std::string& stop_words_text, SegmentOptions options = {});
+    ~SegmentedSearchServer();
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    size_t GetDocumentCount() const;
+    // закрытые сегменты без изменяемого
+    size_t GetSegmentCount() const;
+    // дожидается, пока не останется сегментов, которые политика хотела бы слить
+    void WaitForMerges();
+
+private:
+    struct Segment {
+        std::shared_ptr<const SearchServer> server;
+        std::unordered_set<int> deleted_ids;
+        // сколько удалённых документов сегмента содержат слово
+        std::map<std::string, size_t, std::less<>> deleted_document_freqs;
+
+        size_t GetLiveCount() const;
+    };
+
+    const std::set<std::string, std::less<>> stop_words_;
+    const SegmentOptions options_;
+    mutable std::shared_mutex mutex_;
+    std::unique_ptr<SearchServer> mutable_segment_;
+    std::vector<std::shared_ptr<Segment>> segments_;
+    // закрытый сегмент документа, nullptr - документ в изменяемом
+    std::unordered_map<int, std::shared_ptr<Segment>> document_segments_;
+
+    std::mutex merge_mutex_;
+    std::condition_variable merge_cv_;
+    bool merge_requested_ = false;
+    bool merging_ = false;
+    std::atomic<bool> stopping_{false};
+    std::thread merger_;
+
+    void SealMutableSegment();
+    void RequestMerge();
+    static void MarkDeleted(Segment& segment, int document_id);
+    size_t GetTier(size_t document_count) const;
+    // сегменты для следующего слияния, пусто - сливать нечего; вызывается под mutex_
+    std::vector<std::shared_ptr<Segment>> SelectMergeSources() const;
+    bool MergeOnce();
+    void MergeLoop();
+    CollectionStatistics MakeStatistics() const;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, SegmentOptions options)
+    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+    , options_(options)
+    , mutable_segment_(std::make_unique<SearchServer>(stop_words_))
+    , merger_([this] {
+        MergeLoop();
+    }) {
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(std::string_view raw_query,
+                                                              DocumentPredicate document_predicate) const {
+    std::shared_lock lock(mutex_);
+    const CollectionStatistics statistics = MakeStatistics();
+    std::vector<Document> documents = mutable_segment_->FindTopDocuments(raw_query, document_predicate, statistics);
+    for (const auto& segment : segments_) {
+        std::vector<Document> segment_documents;
+        if (segment->deleted_ids.empty()) {
+            segment_documents = segment->server->FindTopDocuments(raw_query, document_predicate, statistics);
+        }
+        else {
+            const auto& deleted_ids = segment->deleted_ids;
+            segment_documents = segment->server->FindTopDocuments(raw_query,
+                [&deleted_ids, &document_predicate](int document_id, DocumentStatus status, int rating) {
+                    return deleted_ids.count(document_id) == 0 && document_predicate(document_id, status, rating);
+                }, statistics);
+        }
+        documents.insert(documents.end(), segment_documents.begin(), segment_documents.end());
+    }
+    return SelectTopDocuments(documents, mutable_segment_->GetMaxResultDocumentCount());
+}
@@ -0,0 +1,91 @@
+#include "stop_word_filter.h"
+
+#include <algorithm>
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+}  // namespace
+
+StopWordFilter::StopWordFilter(const std::set<std::string, std::less<>>& words)
+    : size_(words.size()) {
+    // пустой фильтр: маска длин пуста, до таблицы дело не доходит
+    if (words.empty()) {
+        return;
+    }
+    std::vector<std::string_view> word_views;
+    for (const std::string& word : words) {
+        word_views.push_back(word);
+        length_mask_ |= uint64_t{1} << std::min<size_t>(word.size(), 63);
+        words_ += word;
+    }
+    // таблица заполнена не больше чем наполовину, в корзине в среднем два слова
+    entries_.resize(RoundUpToPowerOfTwo(words.size() * 2));
+    bucket_seeds_.resize(RoundUpToPowerOfTwo((words.size() + 1) / 2));
+    // затравки не нашлось (например, совпали полные хеши двух слов) - хешируем все слова заново
+    while (!TryBuild(word_views)) {
+        ++hash_seed_;
+    }
+}
+
+size_t StopWordFilter::size() const {
+    return size_;
+}
+
+bool StopWordFilter::TryBuild(const std::vector<std::string_view>& words) {
+    std::fill(entries_.begin(), entries_.end(), Entry{});
+    std::vector<std::vector<size_t>> buckets(bucket_seeds_.size());
+    std::vector<uint64_t> hashes(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        hashes[i] = Hash(words[i], hash_seed_);
+        buckets[hashes[i] & (bucket_seeds_.size() - 1)].push_back(i);
+    }
+    std::vector<size_t> bucket_order(buckets.size());
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+        bucket_order[bucket] = bucket;
+    }
+    // большие корзины размещаются первыми, пока таблица свободна
+    std::stable_sort(bucket_order.begin(), bucket_order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::vector<size_t> offsets(words.size());
+    for (size_t i = 1; i < words.size(); ++i) {
+        offsets[i] = offsets[i - 1] + words[i - 1].size();
+    }
+    std::vector<bool> occupied(entries_.size());
+    std::vector<size_t> indexes;
+    for (const size_t bucket : bucket_order) {
+        const std::vector<size_t>& bucket_words = buckets[bucket];
+        bool placed = bucket_words.empty();
+        for (uint32_t seed = 0; !placed && seed < (1u << 16); ++seed) {
+            bucket_seeds_[bucket] = seed;
+            indexes.clear();
+            placed = true;
+            for (const size_t word : bucket_words) {
+                const size_t index = GetEntryIndex(hashes[word]);
+                if (occupied[index] || std::find(indexes.begin(), indexes.end(), index) != indexes.end()) {
+                    placed = false;
+                    break;
+                }
+                indexes.push_back(index);
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+        for (size_t i = 0; i < bucket_words.size(); ++i) {
+            const size_t word = bucket_words[i];
+            occupied[indexes[i]] = true;
+            entries_[indexes[i]] = {hashes[word], static_cast<uint32_t>(offsets[word]), static_cast<uint32_t>(words[word].size())};
+        }
+    }
+    return true;
+}
\ No newline at end of file
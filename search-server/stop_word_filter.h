@@ -0,0 +1,75 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// неизменяемый фильтр стоп-слов на совершенном хешировании: у каждой корзины своя затравка,
+// подобранная так, чтобы все слова попали в разные ячейки таблицы. проверка слова - маска длин,
+// один хеш, одна ячейка и сравнение с сохранённым словом, без обхода дерева строк
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+    explicit StopWordFilter(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const {
+        if (((length_mask_ >> std::min<size_t>(word.size(), 63)) & 1) == 0) {
+            return false;
+        }
+        const uint64_t hash = Hash(word, hash_seed_);
+        const Entry& entry = entries_[GetEntryIndex(hash)];
+        return entry.hash == hash && entry.length == word.size()
+            && std::memcmp(words_.data() + entry.offset, word.data(), word.size()) == 0;
+    }
+
+    size_t size() const;
+
+private:
+    struct Entry {
+        uint64_t hash = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    // бит i - есть слово длины i, бит 63 - есть слово длины 63 и больше
+    uint64_t length_mask_ = 0;
+    uint64_t hash_seed_ = 0;
+    std::vector<uint32_t> bucket_seeds_;
+    std::vector<Entry> entries_;
+    std::string words_;
+    size_t size_ = 0;
+
+    static uint64_t Mix(uint64_t value) {
+        value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+        return value ^ (value >> 31);
+    }
+
+    // по 8 байт за шаг; результат зависит от порядка байтов платформы и в снимок не попадает
+    static uint64_t Hash(std::string_view word, uint64_t seed) {
+        uint64_t hash = seed ^ (word.size() * 0x9e3779b97f4a7c15ULL);
+        size_t pos = 0;
+        for (; pos + 8 <= word.size(); pos += 8) {
+            uint64_t chunk;
+            std::memcpy(&chunk, word.data() + pos, 8);
+            hash = Mix(hash ^ chunk);
+        }
+        if (pos < word.size()) {
+            uint64_t chunk = 0;
+            std::memcpy(&chunk, word.data() + pos, word.size() - pos);
+            hash = Mix(hash ^ chunk);
+        }
+        return hash;
+    }
+
+    size_t GetEntryIndex(uint64_t hash) const {
+        const uint32_t bucket_seed = bucket_seeds_[hash & (bucket_seeds_.size() - 1)];
+        return Mix(hash ^ bucket_seed) & (entries_.size() - 1);
+    }
+
+    bool TryBuild(const std::vector<std::string_view>& words);
+};
\ No newline at end of file
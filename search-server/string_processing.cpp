@@ -1,14 +1,152 @@
 #include "string_processing.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TOKENIZER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define TOKENIZER_AVX2
+#else
+#define TOKENIZER_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
 
 using namespace std;
 
+namespace {
+
+constexpr size_t TOKENIZER_BLOCK_SIZE = 64;
+
+// битовые маски блока из 64 байт: пробелы и управляющие символы
+struct BlockMasks {
+    uint64_t spaces;
+    uint64_t controls;
+};
+
+[[maybe_unused]] BlockMasks ClassifyBlockScalar(const char* block) {
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < TOKENIZER_BLOCK_SIZE; ++i) {
+        const auto c = static_cast<unsigned char>(block[i]);
+        masks.spaces |= uint64_t{c == ' '} << i;
+        masks.controls |= uint64_t{c < ' '} << i;
+    }
+    return masks;
+}
+
+#ifdef TOKENIZER_X86
+
+// беззнаковое c < 32 как max(c, 31) == 31: у SSE2 нет беззнакового сравнения байтов
+BlockMasks ClassifyBlockSse2(const char* block) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i last_control = _mm_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < TOKENIZER_BLOCK_SIZE; i += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+        const auto spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, space)));
+        const auto controls = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(bytes, last_control), last_control)));
+        masks.spaces |= uint64_t{spaces} << i;
+        masks.controls |= uint64_t{controls} << i;
+    }
+    return masks;
+}
+
+TOKENIZER_AVX2 BlockMasks ClassifyBlockAvx2(const char* block) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i last_control = _mm256_set1_epi8(' ' - 1);
+    BlockMasks masks{0, 0};
+    for (size_t i = 0; i < TOKENIZER_BLOCK_SIZE; i += 32) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i));
+        const auto spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, space)));
+        const auto controls = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(bytes, last_control), last_control)));
+        masks.spaces |= uint64_t{spaces} << i;
+        masks.controls |= uint64_t{controls} << i;
+    }
+    return masks;
+}
+
+#endif
+
+struct TokenizerKernel {
+    const char* name;
+    BlockMasks (*classify)(const char* block);
+};
+
+TokenizerKernel SelectKernel() {
+#ifdef TOKENIZER_X86
+    if (CpuSupportsAvx2()) {
+        return {"avx2", ClassifyBlockAvx2};
+    }
+    return {"sse2", ClassifyBlockSse2};
+#else
+    return {"scalar", ClassifyBlockScalar};
+#endif
+}
+
+const TokenizerKernel& GetKernel() {
+    static const TokenizerKernel kernel = SelectKernel();
+    return kernel;
+}
+
+}  // namespace
+
 vector<string_view> SplitIntoWords(string_view str) {
     vector<string_view> result;
-    str.remove_prefix(min(str.size(),str.find_first_not_of(" ")));
-    while (!str.empty()) {
-       int64_t space = str.find(' ');
-       result.push_back(str.substr(0, space));
-       str.remove_prefix(min(str.size(), str.find_first_not_of(" ", space)));
-    }
+    SplitIntoWords(str, result);
     return result;
+}
+
+size_t SplitIntoWords(string_view text, vector<string_view>& words) {
+    words.clear();
+    const auto classify = GetKernel().classify;
+    size_t first_control = text.size();
+    // начало слова отмечается переходом от пробела к непробелу, конец - обратным переходом;
+    // перед текстом считаем пробел, хвост короче блока дополняется пробелами
+    uint64_t previous_space = 1;
+    bool in_word = false;
+    size_t word_start = 0;
+    char tail[TOKENIZER_BLOCK_SIZE];
+    for (size_t base = 0; base < text.size(); base += TOKENIZER_BLOCK_SIZE) {
+        const char* block = text.data() + base;
+        if (text.size() - base < TOKENIZER_BLOCK_SIZE) {
+            memset(tail, ' ', TOKENIZER_BLOCK_SIZE);
+            memcpy(tail, block, text.size() - base);
+            block = tail;
+        }
+        const BlockMasks masks = classify(block);
+        if (masks.controls != 0 && first_control == text.size()) {
+            first_control = base + CountTrailingZeros(masks.controls);
+        }
+        uint64_t transitions = masks.spaces ^ ((masks.spaces << 1) | previous_space);
+        previous_space = masks.spaces >> 63;
+        for (; transitions != 0; transitions &= transitions - 1) {
+            const size_t pos = base + CountTrailingZeros(transitions);
+            if (in_word) {
+                words.push_back(text.substr(word_start, pos - word_start));
+            }
+            else {
+                word_start = pos;
+            }
+            in_word = !in_word;
+        }
+    }
+    if (in_word) {
+        words.push_back(text.substr(word_start));
+    }
+    if (first_control == text.size()) {
+        return words.size();
+    }
+    // управляющий символ не пробел, поэтому лежит внутри одного из слов
+    return upper_bound(words.begin(), words.end(), first_control, [&text](size_t pos, string_view word) {
+        return pos < static_cast<size_t>(word.data() - text.data());
+    }) - words.begin() - 1;
+}
+
+const char* GetTokenizerName() {
+    return GetKernel().name;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <set>
@@ -7,6 +8,13 @@
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+// разбивает text по пробелам в words за один проход, попутно ищет управляющие символы (байты 0..31).
+// words очищается, но сохраняет ёмкость, поэтому буфер стоит переиспользовать между вызовами.
+// возвращает номер первого слова с управляющим символом или words.size(), если таких нет
+size_t SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+// ядро разбора (avx2, sse2 или scalar), выбранное по возможностям процессора
+const char* GetTokenizerName();
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
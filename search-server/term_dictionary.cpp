@@ -0,0 +1,35 @@
+#include "term_dictionary.h"
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if (const auto it = term_ids_.find(word); it != term_ids_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(words_.size());
+    const std::string_view stored = storage_.Store(word);
+    words_.push_back(stored);
+    term_ids_.emplace(stored, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::InternView(std::string_view word) {
+    if (const auto it = term_ids_.find(word); it != term_ids_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(words_.size());
+    words_.push_back(word);
+    term_ids_.emplace(word, term_id);
+    return term_id;
+}
+
+TermId TermDictionary::Find(std::string_view word) const {
+    const auto it = term_ids_.find(word);
+    return it == term_ids_.end() ? NO_TERM : it->second;
+}
+
+std::string_view TermDictionary::GetWord(TermId term_id) const {
+    return words_.at(term_id);
+}
+
+size_t TermDictionary::size() const {
+    return words_.size();
+}
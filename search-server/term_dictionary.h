@@ -0,0 +1,27 @@
+#pragma once
+#include "text_arena.h"
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using TermId = uint32_t;
+
+// словарь терминов: каждое уникальное слово хранится один раз и получает плотный id
+class TermDictionary {
+public:
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermId Intern(std::string_view word);
+    // слово не копируется: память должна жить не меньше словаря
+    TermId InternView(std::string_view word);
+    TermId Find(std::string_view word) const;
+    std::string_view GetWord(TermId term_id) const;
+    size_t size() const;
+
+private:
+    TextArena storage_;
+    std::vector<std::string_view> words_;
+    std::unordered_map<std::string_view, TermId> term_ids_;
+};
@@ -0,0 +1,460 @@
+#include "test_example_functions.h"
+#include "allocation_counter.h"
+#include "concurrent_map.h"
+#include "concurrent_search_server.h"
+#include "document_filter.h"
+#include "index_snapshot.h"
+#include "log_duration.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "segmented_search_server.h"
+#include "test_framework.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::literals;
+
+namespace {
+
+// прежний ConcurrentMap: std::map в каждой корзине под общим замком
+template <typename Key, typename Value>
+class LegacyConcurrentMap {
+private:
+    struct Bucket {
+        std::mutex mutex;
+        std::map<Key, Value> map;
+    };
+
+public:
+    struct Access {
+        std::lock_guard<std::mutex> guard;
+        Value& ref_to_value;
+
+        Access(const Key& key, Bucket& bucket)
+            : guard(bucket.mutex)
+            , ref_to_value(bucket.map[key]) {
+        }
+    };
+
+    explicit LegacyConcurrentMap(size_t bucket_count)
+        : buckets_(bucket_count) {
+    }
+
+    Access operator[](const Key& key) {
+        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        return { key, bucket };
+    }
+
+    void Delete(const Key& key) {
+        auto& bucket = buckets_[static_cast<uint64_t>(key) % buckets_.size()];
+        std::lock_guard guard(bucket.mutex);
+        bucket.map.erase(key);
+    }
+
+private:
+    std::vector<Bucket> buckets_;
+};
+
+const int KEY_COUNT = 100'000;
+const int OPERATION_COUNT = 4'000'000;
+
+template <typename AddFunction, typename DeleteFunction>
+void RunWorkload(int thread_count, AddFunction add, DeleteFunction remove) {
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < thread_count; ++thread) {
+        threads.emplace_back([thread, thread_count, &add, &remove] {
+            std::mt19937 generator(thread);
+            std::uniform_int_distribution<int> keys(0, KEY_COUNT - 1);
+            for (int operation = 0; operation < OPERATION_COUNT / thread_count; ++operation) {
+                const int key = keys(generator);
+                if (operation % 64 == 0) {
+                    remove(key);
+                }
+                else {
+                    add(key, 0.5);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void AssertEqualDocuments(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+    ASSERT_EQUAL(lhs.size(), rhs.size());
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+        ASSERT_EQUAL(lhs[i].rating, rhs[i].rating);
+        ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+    }
+}
+
+std::string MakeRandomText(std::mt19937& generator, int word_count, int vocabulary_size) {
+    std::uniform_int_distribution<int> words(0, vocabulary_size - 1);
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        text += "word"s + std::to_string(words(generator)) + " "s;
+    }
+    return text;
+}
+
+}  // namespace
+
+void BenchmarkConcurrentMap(std::ostream& out) {
+    for (int thread_count = 1; thread_count <= 64; thread_count *= 2) {
+        {
+            LegacyConcurrentMap<int, double> legacy_map(thread_count * 4);
+            LOG_DURATION_STREAM("std::map buckets, threads = "s + std::to_string(thread_count), out);
+            RunWorkload(thread_count,
+                [&legacy_map](int key, double value) { legacy_map[key].ref_to_value += value; },
+                [&legacy_map](int key) { legacy_map.Delete(key); });
+        }
+        {
+            ConcurrentMap<int, double> striped_map(thread_count * 4);
+            LOG_DURATION_STREAM("open addressing stripes, threads = "s + std::to_string(thread_count), out);
+            RunWorkload(thread_count,
+                [&striped_map](int key, double value) { striped_map[key] += value; },
+                [&striped_map](int key) { striped_map.Delete(key); });
+        }
+    }
+}
+
+void TestQueryContextDoesNotAllocate() {
+    SearchServer search_server("and in on"s);
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> words(0, 199);
+    for (int id = 0; id < 2000; ++id) {
+        std::string text;
+        for (int i = 0; i < 12; ++i) {
+            text += "word"s + std::to_string(words(generator)) + (i % 4 == 0 ? " and "s : " "s);
+        }
+        search_server.AddDocument(id, text, id % 5 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, {id % 7, 3});
+    }
+    const std::vector<std::string> queries = {
+        "word1 word2 word3"s,
+        "word10 -word11 and word12 word13 word14"s,
+        "word5 word5 word6 -word7 -word8"s,
+        "unknown word199"s,
+        "in on"s,
+    };
+
+    SearchServer::QueryContext context;
+    const auto even_ids = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    // прогрев: буферы контекста дорастают до нужной ёмкости
+    for (const std::string& query : queries) {
+        search_server.FindTopDocuments(context, query);
+        search_server.FindTopDocuments(context, query, DocumentStatus::BANNED);
+        search_server.FindTopDocuments(context, query, even_ids);
+    }
+    for (const std::string& query : queries) {
+        ASSERT_EQUAL(search_server.FindTopDocuments(context, query).size(), search_server.FindTopDocuments(query).size());
+        const size_t allocations = CountAllocations([&] {
+            search_server.FindTopDocuments(context, query);
+            search_server.FindTopDocuments(context, query, DocumentStatus::BANNED);
+            search_server.FindTopDocuments(context, query, even_ids);
+        });
+        ASSERT_EQUAL(allocations, 0u);
+    }
+
+    search_server.CompressPostings();
+    for (const std::string& query : queries) {
+        search_server.FindTopDocuments(context, query);
+    }
+    for (const std::string& query : queries) {
+        const std::vector<Document> expected = search_server.FindTopDocuments(query);
+        size_t document_count = 0;
+        const size_t allocations = CountAllocations([&] {
+            document_count = search_server.FindTopDocuments(context, query).size();
+        });
+        ASSERT_EQUAL(allocations, 0u);
+        ASSERT_EQUAL(document_count, expected.size());
+    }
+}
+
+
+void TestNearDuplicatesAreNotChained() {
+    SearchServer search_server(""s);
+    const std::vector<std::string> texts = {"a b c"s, "b c d"s, "c d e"s, "d e f"s, "e f g"s};
+    for (int id = 1; id <= static_cast<int>(texts.size()); ++id) {
+        search_server.AddDocument(id, texts[id - 1], DocumentStatus::ACTUAL, {1});
+    }
+    DuplicateSearchOptions options;
+    options.near_duplicates = true;
+    options.similarity_threshold = 0.5;
+    // полоса из одной строки: соседние документы (мера 0.5) почти наверняка делят корзину
+    options.band_count = 64;
+    options.rows_per_band = 1;
+    // 2 похож на 1, 4 похож на 3, но 3 и 5 с оставленными 1 и 3 делят лишь одно слово
+    const std::vector<int> expected = {2, 4};
+    ASSERT_EQUAL(FindDuplicates(search_server, options), expected);
+    ASSERT_EQUAL(FindDuplicates(std::execution::par, search_server, options), expected);
+}
+
+void TestPurgeRemovedDocumentsKeepsResults() {
+    SearchServer search_server("and"s);
+    // те же живые документы в том же порядке, без удалений
+    SearchServer expected_server("and"s);
+    std::mt19937 generator(7);
+    for (int id = 0; id < 3000; ++id) {
+        const std::string text = MakeRandomText(generator, 8, 100);
+        const DocumentStatus status = id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text, status, {id % 11});
+        if (id % 3 != 0) {
+            expected_server.AddDocument(id, text, status, {id % 11});
+        }
+    }
+    for (int id = 0; id < 3000; id += 3) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.CompressPostings();
+
+    const std::vector<std::string> queries = {"word1 word2 word3"s, "word4 -word5 word6"s, "word7 and word8"s};
+    const DocumentFilter filter = DocumentFilter().SetStatuses({DocumentStatus::BANNED}).SetRatingRange(2, 8);
+    const auto check = [&] {
+        ASSERT_EQUAL(search_server.GetDocumentCount(), expected_server.GetDocumentCount());
+        for (const std::string& query : queries) {
+            AssertEqualDocuments(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query));
+            AssertEqualDocuments(search_server.FindTopDocuments(query, filter), expected_server.FindTopDocuments(query, filter));
+            for (const int id : {2, 5, 3001, 3005}) {
+                if (std::count(expected_server.begin(), expected_server.end(), id) > 0) {
+                    ASSERT(search_server.MatchDocument(query, id) == expected_server.MatchDocument(query, id));
+                }
+            }
+        }
+    };
+    check();
+    // удаление само не чистит списки, память возвращает только явный вызов
+    const size_t memory_usage = search_server.GetPostingsMemoryUsage();
+    search_server.PurgeRemovedDocuments(std::execution::par);
+    ASSERT(search_server.GetPostingsMemoryUsage() < memory_usage);
+    check();
+
+    // новые документы получают слоты за перенумерованными
+    for (int id = 3000; id < 3200; ++id) {
+        const std::string text = MakeRandomText(generator, 8, 100);
+        search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 11});
+        expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 11});
+    }
+    for (int id = 1; id < 3200; id += 7) {
+        search_server.RemoveDocument(id);
+        expected_server.RemoveDocument(id);
+    }
+    check();
+    search_server.PurgeRemovedDocuments();
+    check();
+}
+
+void TestSnapshotChecksPostingsOnFirstUse() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_corrupted.idx").string();
+    {
+        SearchServer search_server("and"s);
+        search_server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+        search_server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, {2});
+        search_server.Save(path);
+    }
+    {
+        // список вхождений слова white (id 0) ссылается на несуществующий слот
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        SnapshotHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        const DocumentSlot slot = 1000;
+        file.seekp(static_cast<std::streamoff>(header.posting_slots));
+        file.write(reinterpret_cast<const char*>(&slot), sizeof(slot));
+    }
+    {
+        const SearchServer search_server(IndexSnapshotPath{path});
+        ASSERT_EQUAL(search_server.FindTopDocuments("dog"s).size(), 1u);
+        ASSERT_THROWS(search_server.FindTopDocuments("white"s), std::runtime_error);
+        ASSERT_THROWS(search_server.FindTopDocuments("dog -white"s), std::runtime_error);
+    }
+    std::filesystem::remove(path);
+}
+
+void TestSnapshotRoundTrip() {
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_round_trip.idx").string();
+    SearchServer search_server("and in on"s);
+    search_server.SetDuplicatePolicy(DuplicatePolicy::FLAG);
+    std::mt19937 generator(11);
+    std::string text;
+    for (int id = 0; id < 500; ++id) {
+        // каждый десятый документ повторяет набор слов предыдущего
+        if (id % 10 != 9) {
+            text = MakeRandomText(generator, 6, 60);
+        }
+        const DocumentStatus status = id % 5 == 0 ? DocumentStatus::IRRELEVANT : DocumentStatus::ACTUAL;
+        search_server.AddDocument(id, text + "and"s, status, {id % 9, -1});
+    }
+    for (int id = 0; id < 500; id += 4) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.Save(path);
+
+    {
+        SearchServer loaded_server(IndexSnapshotPath{path});
+        const std::vector<std::string> queries = {"word1 word2"s, "word3 -word4 in"s, "word5 word6 -word7"s};
+        const DocumentFilter filter = DocumentFilter().SetStatuses({DocumentStatus::IRRELEVANT}).SetRatingRange(1, 5);
+        const auto check = [&] {
+            ASSERT_EQUAL(loaded_server.GetDocumentCount(), search_server.GetDocumentCount());
+            ASSERT(std::equal(loaded_server.begin(), loaded_server.end(), search_server.begin(), search_server.end()));
+            for (const std::string& query : queries) {
+                AssertEqualDocuments(loaded_server.FindTopDocuments(query), search_server.FindTopDocuments(query));
+                AssertEqualDocuments(loaded_server.FindTopDocuments(query, filter), search_server.FindTopDocuments(query, filter));
+                AssertEqualDocuments(loaded_server.FindTopDocuments(std::execution::par, query, DocumentStatus::IRRELEVANT),
+                                     search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::IRRELEVANT));
+                for (const int id : search_server) {
+                    ASSERT(loaded_server.MatchDocument(query, id) == search_server.MatchDocument(query, id));
+                }
+            }
+            for (const int id : search_server) {
+                ASSERT_EQUAL(loaded_server.IsDuplicate(id), search_server.IsDuplicate(id));
+            }
+        };
+        ASSERT(loaded_server.GetDuplicatePolicy() == DuplicatePolicy::FLAG);
+        ASSERT(loaded_server.IsDuplicate(19));
+        check();
+
+        // изменения снимка копируют затронутые списки из отображённого файла
+        for (int id = 500; id < 600; ++id) {
+            if (id % 10 != 9) {
+                text = MakeRandomText(generator, 6, 60);
+            }
+            search_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 9});
+            loaded_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id % 9});
+        }
+        for (int id = 1; id < 600; id += 6) {
+            search_server.RemoveDocument(id);
+            loaded_server.RemoveDocument(id);
+        }
+        check();
+        loaded_server.PurgeRemovedDocuments();
+        loaded_server.CompressPostings();
+        check();
+    }
+    std::filesystem::remove(path);
+}
+
+void TestConcurrentSearchServerPublish() {
+    const int BATCH_SIZE = 10;
+    const int BATCH_COUNT = 40;
+    ConcurrentSearchServer server("and"s);
+    std::atomic<bool> is_done{false};
+    std::atomic<int> failure_count{0};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 4; ++reader) {
+        readers.emplace_back([&] {
+            size_t last_count = 0;
+            while (!is_done.load()) {
+                // поколение видно целиком: документы публикуются пачками и только добавляются
+                const auto snapshot = server.GetSnapshot();
+                const size_t count = snapshot->GetDocumentCount();
+                const size_t expected_size = std::min(count, snapshot->GetMaxResultDocumentCount());
+                if (count % BATCH_SIZE != 0 || count < last_count
+                    || snapshot->FindTopDocuments("common"s).size() != expected_size) {
+                    ++failure_count;
+                }
+                last_count = count;
+            }
+        });
+    }
+    for (int batch = 0; batch < BATCH_COUNT; ++batch) {
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            const int id = batch * BATCH_SIZE + i;
+            server.AddDocument(id, "common word"s + std::to_string(id % 7) + " and"s, DocumentStatus::ACTUAL, {id % 5});
+        }
+        // бросившие изменения не попадают ни в черновик, ни в журнал
+        ASSERT_THROWS(server.AddDocument(batch, "repeated id"s, DocumentStatus::ACTUAL, {1}), std::invalid_argument);
+        ASSERT_THROWS(server.Update([](SearchServer&) {
+            throw std::runtime_error("update failed"s);
+        }), std::runtime_error);
+        server.Publish();
+    }
+    is_done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(failure_count.load(), 0);
+    ASSERT_EQUAL(server.GetSnapshot()->GetDocumentCount(), static_cast<size_t>(BATCH_SIZE * BATCH_COUNT));
+
+    // две публикации подряд показывают обе копии: вторая получила изменения повтором журнала
+    server.RemoveDocument(3);
+    server.Update([](SearchServer& search_server) {
+        search_server.RemoveDocument(15);
+        search_server.PurgeRemovedDocuments();
+    });
+    server.Publish();
+    const std::vector<std::string> queries = {"common"s, "word3 -word4"s, "word5 word6"s};
+    std::vector<std::vector<Document>> first_copy_results;
+    {
+        // снимок отпускается до Publish, иначе тот будет ждать его вечно
+        const auto first_copy = server.GetSnapshot();
+        ASSERT_EQUAL(first_copy->GetDocumentCount(), static_cast<size_t>(BATCH_SIZE * BATCH_COUNT - 2));
+        for (const std::string& query : queries) {
+            first_copy_results.push_back(first_copy->FindTopDocuments(query));
+        }
+    }
+    server.RemoveDocument(-1);
+    server.Publish();
+    const auto second_copy = server.GetSnapshot();
+    ASSERT_EQUAL(second_copy->GetDocumentCount(), static_cast<size_t>(BATCH_SIZE * BATCH_COUNT - 2));
+    for (size_t i = 0; i < queries.size(); ++i) {
+        AssertEqualDocuments(second_copy->FindTopDocuments(queries[i]), first_copy_results[i]);
+    }
+}
+
+void TestSegmentedSearchServerMatchesSingleServer() {
+    SegmentOptions options;
+    options.max_mutable_documents = 32;
+    options.merge_factor = 2;
+    SegmentedSearchServer segmented_server("and in"s, options);
+    SearchServer search_server("and in"s);
+    std::mt19937 generator(5);
+    const std::vector<std::string> queries = {"word1 word2"s, "word3 -word4 and"s, "word5 word6 word7"s, "word8 in"s};
+    const DocumentFilter filter = DocumentFilter().SetStatuses({DocumentStatus::ACTUAL}).SetRatingRange(100, 400);
+    const auto check = [&] {
+        ASSERT_EQUAL(segmented_server.GetDocumentCount(), search_server.GetDocumentCount());
+        for (const std::string& query : queries) {
+            AssertEqualDocuments(segmented_server.FindTopDocuments(query), search_server.FindTopDocuments(query));
+            AssertEqualDocuments(segmented_server.FindTopDocuments(query, DocumentStatus::BANNED),
+                                 search_server.FindTopDocuments(query, DocumentStatus::BANNED));
+            AssertEqualDocuments(segmented_server.FindTopDocuments(query, filter), search_server.FindTopDocuments(query, filter));
+        }
+    };
+    int next_id = 0;
+    for (int round = 0; round < 12; ++round) {
+        for (int i = 0; i < 50; ++i, ++next_id) {
+            const std::string text = MakeRandomText(generator, 7, 40);
+            const DocumentStatus status = next_id % 6 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+            // рейтинг равен id, так что порядок выдачи не зависит от разрешения ничьих по релевантности
+            segmented_server.AddDocument(next_id, text, status, {next_id});
+            search_server.AddDocument(next_id, text, status, {next_id});
+        }
+        // удаляются документы и закрытых сегментов, и изменяемого
+        for (int id = round; id < next_id; id += 5 + round) {
+            segmented_server.RemoveDocument(id);
+            search_server.RemoveDocument(id);
+        }
+        check();
+        if (round % 3 == 2) {
+            segmented_server.WaitForMerges();
+            check();
+        }
+    }
+    segmented_server.WaitForMerges();
+    // закрытые сегменты действительно сливались
+    ASSERT(segmented_server.GetSegmentCount() < static_cast<size_t>(next_id) / options.max_mutable_documents);
+    check();
+}
\ No newline at end of file
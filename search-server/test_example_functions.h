@@ -0,0 +1,27 @@
+#pragma once
+#include <iostream>
+
+// сравнение ConcurrentMap с прежней реализацией на std::map под замками, от 1 до 64 потоков
+void BenchmarkConcurrentMap(std::ostream& out = std::cerr);
+
+// после прогрева поиск с SearchServer::QueryContext не выделяет память: подсчёт через замену operator new
+void TestQueryContextDoesNotAllocate();
+
+
+// почти-дубликаты сравниваются с оставленным документом группы: цепочка похожих соседей не склеивается
+void TestNearDuplicatesAreNotChained();
+
+// PurgeRemovedDocuments перенумеровывает слоты, не меняя выдачу, и возвращает память списков
+void TestPurgeRemovedDocumentsKeepsResults();
+
+// снимок открывается без проверки списков вхождений, испорченный список обнаруживается первым запросом
+void TestSnapshotChecksPostingsOnFirstUse();
+
+// сервер, открытый из снимка, отвечает как исходный и остаётся изменяемым
+void TestSnapshotRoundTrip();
+
+// читатели ConcurrentSearchServer видят поколения целиком, копии сходятся после повтора журнала
+void TestConcurrentSearchServerPublish();
+
+// SegmentedSearchServer отвечает как один SearchServer до и после слияний сегментов
+void TestSegmentedSearchServerMatchesSingleServer();
\ No newline at end of file
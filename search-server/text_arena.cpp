@@ -0,0 +1,44 @@
+#include "text_arena.h"
+
+#include <cstring>
+#include <iterator>
+
+std::string_view TextArena::Store(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    if (text.size() > BLOCK_SIZE) {
+        // длинный текст получает отдельный блок, а текущий блок остаётся последним и продолжает заполняться
+        Block block{std::make_unique<char[]>(text.size()), text.size(), text.size()};
+        std::memcpy(block.data.get(), text.data(), text.size());
+        const std::string_view result(block.data.get(), text.size());
+        blocks_.insert(blocks_.empty() ? blocks_.end() : std::prev(blocks_.end()), std::move(block));
+        stored_bytes_ += text.size();
+        return result;
+    }
+    if (blocks_.empty() || blocks_.back().capacity - blocks_.back().used < text.size()) {
+        blocks_.push_back({std::make_unique<char[]>(BLOCK_SIZE), BLOCK_SIZE, 0});
+    }
+    Block& block = blocks_.back();
+    char* destination = block.data.get() + block.used;
+    std::memcpy(destination, text.data(), text.size());
+    block.used += text.size();
+    stored_bytes_ += text.size();
+    return {destination, text.size()};
+}
+
+void TextArena::Release(std::string_view text) {
+    released_bytes_ += text.size();
+}
+
+size_t TextArena::GetStoredBytes() const {
+    return stored_bytes_;
+}
+
+size_t TextArena::GetReleasedBytes() const {
+    return released_bytes_;
+}
+
+bool TextArena::NeedsCompaction() const {
+    return released_bytes_ >= BLOCK_SIZE && released_bytes_ * 2 > stored_bytes_;
+}
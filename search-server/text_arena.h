@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// хранилище строк только на дописывание: байты лежат в цепочке блоков, которые не перевыделяются,
+// поэтому выданные string_view остаются валидными, пока жива арена
+class TextArena {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::string_view Store(std::string_view text);
+    // только учёт: место освобождается при уплотнении, т.е. переносе живых строк в новую арену
+    void Release(std::string_view text);
+
+    size_t GetStoredBytes() const;
+    size_t GetReleasedBytes() const;
+    bool NeedsCompaction() const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t capacity = 0;
+        size_t used = 0;
+    };
+
+    std::vector<Block> blocks_;
+    size_t stored_bytes_ = 0;
+    size_t released_bytes_ = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+// объект T из кэша текущего потока на время жизни обёртки. вложенное использование в том же потоке
+// (например, рабочий пула, выполняющий чужую задачу во время ожидания) получает отдельный объект,
+// поэтому буферы не портятся, а после прогрева новые объекты не создаются
+template <typename T>
+class ThreadLocalScratch {
+public:
+    ThreadLocalScratch()
+        : object_(Acquire()) {
+    }
+
+    ~ThreadLocalScratch() {
+        GetCache().push_back(std::move(object_));
+    }
+
+    ThreadLocalScratch(const ThreadLocalScratch&) = delete;
+    ThreadLocalScratch& operator=(const ThreadLocalScratch&) = delete;
+
+    T& operator*() const {
+        return *object_;
+    }
+
+    T* operator->() const {
+        return object_.get();
+    }
+
+private:
+    std::unique_ptr<T> object_;
+
+    static std::vector<std::unique_ptr<T>>& GetCache() {
+        thread_local std::vector<std::unique_ptr<T>> cache;
+        return cache;
+    }
+
+    static std::unique_ptr<T> Acquire() {
+        std::vector<std::unique_ptr<T>>& cache = GetCache();
+        if (cache.empty()) {
+            return std::make_unique<T>();
+        }
+        std::unique_ptr<T> object = std::move(cache.back());
+        cache.pop_back();
+        return object;
+    }
+};
\ No newline at end of file
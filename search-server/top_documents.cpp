@@ -0,0 +1,75 @@
+#include "top_documents.h"
+
+#include <cmath>
+
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < RELEVANCE_EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+TopDocumentsHeap::TopDocumentsHeap(size_t max_count)
+    : max_count_(max_count) {
+}
+
+void TopDocumentsHeap::Reset(size_t max_count) {
+    max_count_ = max_count;
+    heap_.clear();
+}
+
+void TopDocumentsHeap::Push(const Document& document) {
+    if (max_count_ == 0) {
+        return;
+    }
+    if (heap_.size() < max_count_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), WorseFirst{});
+    }
+    else if (IsMoreRelevant(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), WorseFirst{});
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), WorseFirst{});
+    }
+}
+
+void TopDocumentsHeap::Merge(const TopDocumentsHeap& other) {
+    for (const Document& document : other.heap_) {
+        Push(document);
+    }
+}
+
+bool TopDocumentsHeap::IsFull() const {
+    return heap_.size() == max_count_;
+}
+
+const Document& TopDocumentsHeap::Worst() const {
+    return heap_.front();
+}
+
+size_t TopDocumentsHeap::size() const {
+    return heap_.size();
+}
+
+std::vector<Document> TopDocumentsHeap::Extract() {
+    std::vector<Document> result;
+    ExtractTo(result);
+    return result;
+}
+
+void TopDocumentsHeap::ExtractTo(std::vector<Document>& result) {
+    result.resize(heap_.size());
+    for (auto it = result.rbegin(); it != result.rend(); ++it) {
+        std::pop_heap(heap_.begin(), heap_.end(), WorseFirst{});
+        *it = heap_.back();
+        heap_.pop_back();
+    }
+}
+
+std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, size_t max_count) {
+    TopDocumentsHeap heap(max_count);
+    for (const Document& document : documents) {
+        heap.Push(document);
+    }
+    return heap.Extract();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "document.h"
+#include "query_executor.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+const double RELEVANCE_EPSILON = 1e-6;
+
+// релевантность сравнивается с точностью до RELEVANCE_EPSILON, при равенстве выше рейтинг
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// куча из не более чем k документов, в вершине - наименее релевантный из отобранных
+class TopDocumentsHeap {
+public:
+    explicit TopDocumentsHeap(size_t max_count);
+
+    // опустошает кучу, сохраняя выделенную память
+    void Reset(size_t max_count);
+
+    void Push(const Document& document);
+    void Merge(const TopDocumentsHeap& other);
+
+    bool IsFull() const;
+    const Document& Worst() const;
+    size_t size() const;
+
+    // документы в порядке убывания релевантности, куча при этом опустошается
+    std::vector<Document> Extract();
+    // то же в готовый буфер, чтобы переиспользовать его память
+    void ExtractTo(std::vector<Document>& result);
+
+private:
+    struct WorseFirst {
+        bool operator()(const Document& lhs, const Document& rhs) const {
+            return IsMoreRelevant(lhs, rhs);
+        }
+    };
+
+    size_t max_count_;
+    std::vector<Document> heap_;
+};
+
+std::vector<Document> SelectTopDocuments(const std::vector<Document>& documents, size_t max_count);
+
+template <typename ExecutionPolicy>
+std::vector<Document> SelectTopDocuments(const ExecutionPolicy& policy, const std::vector<Document>& documents, size_t max_count) {
+    if constexpr (std::is_same_v<ExecutionPolicy, std::execution::sequenced_policy>) {
+        return SelectTopDocuments(documents, max_count);
+    }
+    else {
+        // каждый поток отбирает лучших в своём куске, затем кучи сливаются
+        const size_t min_chunk_size = 4096;
+        const size_t chunk_count = std::max<size_t>(1, std::min<size_t>(
+            GetParallelism(policy), documents.size() / min_chunk_size));
+        if (chunk_count == 1) {
+            return SelectTopDocuments(documents, max_count);
+        }
+        std::vector<TopDocumentsHeap> heaps(chunk_count, TopDocumentsHeap(max_count));
+        ForEachIndex(policy, chunk_count, [&](size_t chunk) {
+            const size_t first = documents.size() * chunk / chunk_count;
+            const size_t last = documents.size() * (chunk + 1) / chunk_count;
+            for (size_t i = first; i < last; ++i) {
+                heaps[chunk].Push(documents[i]);
+            }
+        });
+        for (size_t chunk = 1; chunk < chunk_count; ++chunk) {
+            heaps[0].Merge(heaps[chunk]);
+        }
+        return heaps[0].Extract();
+    }
+}